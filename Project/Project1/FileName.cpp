@@ -1,9 +1,17 @@
 ﻿#define _CRT_SECURE_NO_WARNINGS
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <time.h>
-#include <math.h>
+#include "ecosystem.h"
+#include "render.h"
+#include "profile.h"
+#include "surrogate.h"
+#include "replay.h"
+#include "species.h"
+#include "domain.h"
+#include "density.h"
+#include "telemetry.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #ifdef _WIN32
 #include <conio.h>
@@ -13,85 +21,124 @@
 #include <unistd.h>
 #include <termios.h>
 #include <poll.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+
+extern char** environ;
 
 int _kbhit() {
     struct pollfd pfd = { .fd = STDIN_FILENO, .events = POLLIN };
     return poll(&pfd, 1, 0) > 0;
 }
 int _getch() {
-    struct termios old, new;
+    struct termios old, raw;
     int ch;
     tcgetattr(STDIN_FILENO, &old);
-    new = old;
-    new.c_lflag &= ~(ICANON | ECHO);
-    tcsetattr(STDIN_FILENO, TCSANOW, &new);
+    raw = old;
+    raw.c_lflag &= ~(ICANON | ECHO);
+    tcsetattr(STDIN_FILENO, TCSANOW, &raw);
     ch = getchar();
     tcsetattr(STDIN_FILENO, TCSANOW, &old);
     return ch;
 }
 #endif
 
-#define GRID_SIZE 28
-#define MAX_ENTITIES (GRID_SIZE * GRID_SIZE)
-#define HISTORY_SIZE 50
+#define MAX_SWEEP_AXES 8     // 参数扫描最多的维数
+#define MAX_SWEEP_VALUES 64  // 每一维最多的取值个数
+#define VALIDATE_ROWS 10     // 替代模型验证报告中逐回合对照的行数
+#define REPLAY_MAX_FPS (RENDER_FPS * 2048) // 回放的最快速度（帧/秒）
+
+int thread_count = 0;     // 0 表示使用全部核心
+int saved_delay_ms = 250; // 全速运行前的间隔，再按 F 时恢复
 
-typedef enum {
-    EMPTY = 0, GRASS, RABBIT, WOLF
-} EntityType;
+// 批处理（无界面）模式参数
+int batch_mode = 0;
+int batch_ticks = 1000;
+int csv_output = 0; // 批处理结果以一行 CSV 输出，供参数扫描的父进程解析
+int census_report = 0; // --census：批处理结束时另外输出各物种的能量、年龄分布
+
+// 参数扫描：每一维是一个命令行参数及其取值列表，各维取值的全组合各重复 sweep_replicates 次，
+// 每次模拟由一个子进程以 --batch --csv 运行
+typedef struct {
+    char name[32];
+    char* values[MAX_SWEEP_VALUES];
+    int count;
+} SweepAxis;
 
+// 替代模型验证报告中的一行：某回合结束时模拟与替代模型的数量
 typedef struct {
-    int x, y;
-    int energy;
-    int age;
-    int max_age;
-    EntityType type;
-    int grass_regrow_timer;
-} Entity;
-
-Entity grid[GRID_SIZE][GRID_SIZE];
-int rabbit_count = 0, wolf_count = 0, grass_count = 0;
-int tick = 0;
-int paused = 0;
-int delay_ms = 250;
-int season = 0;
-int start_season = 0; // 用户选择的起始季节
-const char* season_names[4] = { "春季", "夏季", "秋季", "冬季" };
-
-int history_r[HISTORY_SIZE] = { 0 };
-int history_w[HISTORY_SIZE] = { 0 };
-int hist_index = 0;
-
-int max_rabbits = 0, max_wolves = 0;
-int min_rabbits = 9999, min_wolves = 9999;
-
-int init_grass = 250;
-int init_rabbits = 50;
-int init_wolves = 0;
-
-char message[128] = { 0 };
-int message_timeout = 0;
+    int tick;
+    SurrogateState agent, model;
+} ValidateRow;
 
+// 批处理结束时的统计，模拟与替代模型以同样的格式输出，参数扫描的父进程再解析回来。
+// 数量用 double 存放（替代模型的数量不是整数），各物种的数组按物种编号排列
+typedef struct {
+    double grass, counts[ANIMAL_SPECIES];
+    double max_counts[ANIMAL_SPECIES], min_counts[ANIMAL_SPECIES]; // 谷值不计 0，没有过时为 0
+    int extinct_ticks[ANIMAL_SPECIES];                           // -1 表示未灭绝
+    double means[ANIMAL_SPECIES], mean_grass;
+} BatchSummary;
+
+int sweep_mode = 0;
+SweepAxis sweep_axes[MAX_SWEEP_AXES];
+int sweep_axis_count = 0;
+int sweep_replicates = 1;
+int sweep_jobs = 0; // 同时运行的子进程数，0 表示核心数
+const char* sweep_out = NULL;
+const char* program_path = NULL;
+
+const char* resume_path = NULL;     // --resume：从存档继续
+const char* checkpoint_path = NULL; // --checkpoint：批处理结束时写入存档
+
+const char* stats_path = NULL;     // --stats：每回合统计的输出文件
+const char* density_path = NULL;   // --density：初始放置的密度图 (density.h)
+const char* profile_path = NULL;   // --profile：退出时写入性能统计 (JSON)
+const char* telemetry_spec = NULL; // --telemetry：本机监控端点的端口或 Unix 套接字路径 (telemetry.h)
+
+// 平均场替代模型 (surrogate.h)
+const char* fit_surrogate_path = NULL; // --fit-surrogate：批处理时用每回合的数量拟合系数，结束时写入文件
+const char* surrogate_path = NULL;     // --surrogate：用替代模型代替智能体模拟
+int validate_surrogate = 0;            // --validate：照常模拟，同时推进替代模型并报告两者的偏差
+SurrogateModel surrogate_model;
+
+// 录制与回放 (replay.h)
+const char* record_path = NULL; // --record：把每回合的画面和按键录制到文件
+const char* replay_path = NULL; // --replay：回放录制文件，不进行模拟
+
+// 交互模式的三个线程：模拟线程按截止时间推进回合，渲染线程（主线程）以固定帧率
+// 取最新发布的画面，输入线程在整个会话期间保持终端原始模式读取按键。
+// 会修改世界的命令（重置、保存）交给模拟线程在回合之间执行
+std::atomic<int> quit_requested(0);
+std::atomic<int> pending_command(0); // 'r' 重置，'s' 保存，0 无
+
+int parse_args(int argc, char** argv);
+int species_option(const char* opt, int** target, double** real_target);
+void print_usage(const char* prog);
+int run_batch();
+void summarize_run(BatchSummary* sum);
+void print_summary(const BatchSummary* sum, int ticks, double seconds);
+int parse_summary_csv(const char* line, BatchSummary* sum);
+int run_surrogate();
+int start_recording();
+int run_replay();
+int add_sweep_axis(const char* spec);
+int run_sweep();
 void clear_screen();
 void show_welcome();
 void prompt_initial_counts();
 void prompt_start_season(); // 新增：选择起始季节
 int get_valid_input(int min_val, int max_val);
 int get_season_input();
-void print_map();
-void print_status();
-void print_history_chart();
-void print_legend();
-void print_controls();
-void initialize_grid();
-void spawn_random(EntityType type, int count);
-void update_season();
-void update_grass();
-void update_entities();
-int find_nearest_in_original_grid(EntityType me, EntityType target, int x, int y, int* out_x, int* out_y);
-void handle_reproduction_in_new_grid(Entity* parent, Entity new_grid[GRID_SIZE][GRID_SIZE]);
-int is_valid(int x, int y);
+void simulation_loop();
+void input_loop();
+int read_key(int timeout_ms);
+void term_raw_begin();
+void term_raw_end();
 void save_snapshot();
-void set_message(const char* msg);
+void write_profile();
 
 int is_speed_up_key(int key) {
     return (key == '+' || key == '=');
@@ -100,95 +147,1263 @@ int is_speed_down_key(int key) {
     return (key == '-');
 }
 
-int main() {
-    srand((unsigned int)time(NULL));
-    show_welcome();
-    prompt_initial_counts();
-    prompt_start_season(); // 新增步骤
-    initialize_grid();
+int main(int argc, char** argv) {
+    rand_seed = (unsigned int)time(NULL);
+    program_path = argv[0];
+    int parsed = parse_args(argc, argv);
+    if (parsed <= 0) return parsed < 0 ? 1 : 0;
+    if (telemetry_spec && (sweep_mode || replay_path || (surrogate_path && !validate_surrogate))) {
+        fprintf(stderr, "--telemetry 只用于逐格模拟（批处理或交互模式），不能与 --sweep、--replay 或单独的 --surrogate 同时使用\n");
+        return 1;
+    }
+    if (sweep_mode) {
+        if (resume_path) {
+            fprintf(stderr, "参数扫描不支持 --resume\n");
+            return 1;
+        }
+        return run_sweep();
+    }
+    if (replay_path) return run_replay();
+    if (surrogate_path && !surrogate_load(surrogate_path, &surrogate_model)) {
+        fprintf(stderr, "无法读取替代模型: %s\n", surrogate_path);
+        return 1;
+    }
+    const int rabbit = SPECIES_OF(RABBIT), wolf = SPECIES_OF(WOLF);
+    if (surrogate_path && (surrogate_model.rabbit_breed_prob != species_breed_prob[rabbit]
+        || surrogate_model.rabbit_breed_energy != species_breed_energy[rabbit]
+        || surrogate_model.wolf_breed_prob != species_breed_prob[wolf]
+        || surrogate_model.wolf_breed_energy != species_breed_energy[wolf])) {
+        fprintf(stderr, "注意：替代模型是在另一组繁殖参数下拟合的（兔 %.2f/%d，狼 %.2f/%d），它不随这些参数变化\n",
+            surrogate_model.rabbit_breed_prob, surrogate_model.rabbit_breed_energy,
+            surrogate_model.wolf_breed_prob, surrogate_model.wolf_breed_energy);
+    }
+    for (int s = 0; surrogate_path && s < ANIMAL_SPECIES; s++) {
+        if (s != rabbit && s != wolf && species_init[s] > 0)
+            fprintf(stderr, "注意：替代模型只含青草、兔子和狼，不模拟%s\n", SPECIES[s].name);
+    }
+    if (validate_surrogate && !surrogate_path) {
+        fprintf(stderr, "--validate 需要用 --surrogate 指定替代模型\n");
+        return 1;
+    }
+    if (process_count > 1 && (!batch_mode || checkpoint_path || record_path)) {
+        // 各进程只保存自己那一段地图，存档和录制需要整张地图
+        fprintf(stderr, "--procs 只用于批处理模式，且不能与 --checkpoint、--record 同时使用\n");
+        return 1;
+    }
+    if (surrogate_path && !validate_surrogate) {
+        if (resume_path) {
+            fprintf(stderr, "替代模型不支持 --resume（可与 --validate 一起使用）\n");
+            return 1;
+        }
+        return run_surrogate();
+    }
+#ifdef _OPENMP
+    if (thread_count > 0) omp_set_num_threads(thread_count);
+#endif
+    if (resume_path) {
+        if (!load_checkpoint(resume_path)) return 1;
+        // 再解析一次命令行，让显式给出的参数（如种子、繁殖参数）覆盖存档中的设置，从存档分支出新实验
+        int saved_w = grid_w, saved_h = grid_h;
+        parse_args(argc, argv);
+        if (grid_w != saved_w || grid_h != saved_h) {
+            fprintf(stderr, "从存档继续时不能修改地图尺寸（存档为 %d x %d）\n", saved_w, saved_h);
+            free_world();
+            return 1;
+        }
+    }
+    else if (!alloc_world()) {
+        fprintf(stderr, "内存不足：无法分配 %d x %d 的地图\n", grid_w, grid_h);
+        return 1;
+    }
+    rng_init(rand_seed);
+    if (density_path && !density_load(density_path)) {
+        free_world();
+        return 1;
+    }
+    if (stats_path && !stats_open(stats_path)) {
+        fprintf(stderr, "无法创建统计文件: %s\n", stats_path);
+        free_world();
+        return 1;
+    }
+    if (batch_mode) {
+        int ret = run_batch();
+        if (!recorder_close()) {
+            fprintf(stderr, "录制文件写入失败: %s\n", record_path);
+            ret = 1;
+        }
+        telemetry_stop();
+        write_profile();
+        stats_close();
+        free_world();
+        return ret;
+    }
 
-    int input;
-    while (1) {
-        clear_screen();
-        update_season();
-        print_map();
-        print_status();
-        print_history_chart();
-        print_legend();
-        print_controls();
+    if (!resume_path) {
+        show_welcome();
+        prompt_initial_counts();
+        prompt_start_season(); // 新增步骤
+        initialize_grid();
+    }
+    if (!start_recording()) {
+        stats_close();
+        free_world();
+        return 1;
+    }
+    if (telemetry_spec && !telemetry_start(telemetry_spec)) {
+        recorder_close();
+        stats_close();
+        free_world();
+        return 1;
+    }
 
-        if (message_timeout > 0) {
-            printf("\n>>> %s\n", message);
-            message_timeout--;
+    publish_view();
+    term_raw_begin();
+    std::thread sim_thread(simulation_loop);
+    std::thread key_thread(input_loop);
+
+    // 主线程负责渲染：按固定帧率取最新画面，只在有新画面或提示信息时重绘
+    render_invalidate();
+    int shown_serial = -1;
+    double next_frame = now_seconds();
+    while (!quit_requested.load()) {
+        {
+            std::lock_guard<std::mutex> lock(view_mutex);
+            if (view.serial != shown_serial || message_timeout > 0) {
+                render_frame();
+                shown_serial = view.serial;
+            }
         }
+        view_wanted.store(1);
+        next_frame += 1.0 / RENDER_FPS;
+        double wait = next_frame - now_seconds();
+        if (wait > 0) usleep((int)(wait * 1e6));
+        else next_frame = now_seconds();
+    }
+    sim_thread.join();
+    key_thread.join();
+    term_raw_end();
+    telemetry_stop();
 
-        if (!paused) {
-            update_grass();
-            update_entities();
+    render_free();
+    clear_screen();
+    if (!recorder_close()) fprintf(stderr, "录制文件写入失败: %s\n", record_path);
+    printf("\n感谢使用生态系统模拟器！\n");
+    printf("  草按季节再生 | 起始季节: %s\n", season_names[start_season]);
+    printf("食物链：青草 -> 兔子 -> 狼\n\n");
+    write_profile();
+    stats_close();
+    free_world();
+    if (view.glyphs) free(view.glyphs);
+    return 0;
+}
 
-            history_r[hist_index] = rabbit_count;
-            history_w[hist_index] = wolf_count;
-            hist_index = (hist_index + 1) % HISTORY_SIZE;
+// 模拟线程：执行输入线程转来的命令，按 delay_ms 的截止时间推进回合（为 0 时全速），
+// 渲染线程需要时发布画面
+void simulation_loop() {
+    double deadline = now_seconds();
+    while (!quit_requested.load()) {
+        int command = pending_command.exchange(0);
+        if (command == 'r') {
+            rng_init(++rand_seed); // 换一个种子，重置后得到新的随机世界
+            initialize_grid();
+            tick = 0;
+#ifdef ECO_PROFILE
+            prof_reset();
+#endif
+            recorder_frame();
+            set_message("生态系统已重置！");
+            view_wanted.store(1);
+        }
+        else if (command == 's') {
+            save_snapshot();
+        }
 
-            if (rabbit_count > max_rabbits) max_rabbits = rabbit_count;
-            if (wolf_count > max_wolves) max_wolves = wolf_count;
-            if (rabbit_count > 0 && rabbit_count < min_rabbits) min_rabbits = rabbit_count;
-            if (wolf_count > 0 && wolf_count < min_wolves) min_wolves = wolf_count;
+        if (paused.load()) {
+            if (view_wanted.load()) publish_view();
+            usleep(5000);
+            deadline = now_seconds();
+            continue;
+        }
 
-            tick++;
+        double t0 = now_seconds();
+        update_grass();
+        double t1 = now_seconds();
+        update_entities();
+        double t2 = now_seconds();
+        record_tick_stats();
+        tick++;
+        update_season();
+        recorder_frame();
+        const double phases[TELE_PHASES] = { t1 - t0, t2 - t1, 0.0, now_seconds() - t2 };
+        telemetry_publish(phases, 0);
+        if (view_wanted.load()) publish_view();
+
+        int delay = delay_ms.load();
+        double now = now_seconds();
+        if (delay == 0) {
+            deadline = now;
+            continue;
+        }
+        deadline += delay / 1000.0;
+        if (deadline < now - 0.25) deadline = now; // 落后太多时不再追赶，避免恢复后连续快进
+        // 分段休眠，以便及时响应退出和命令
+        while (!quit_requested.load() && !pending_command.load() && !paused.load()) {
+            double wait = deadline - now_seconds();
+            if (wait <= 0) break;
+            usleep((int)((wait < 0.01 ? wait : 0.01) * 1e6));
         }
+    }
+}
 
-        if (_kbhit()) {
-            input = _getch();
-            int handled = 1;
-            if (input == ' ') {
-                paused = !paused;
-                set_message(paused ? "【已暂停】按空格继续" : "【已继续】模拟运行中");
+// 输入线程：终端保持原始模式，逐个读取按键；控制量直接修改，修改世界的命令转交模拟线程
+void input_loop() {
+    while (!quit_requested.load()) {
+        int input = read_key(50);
+        if (input < 0) continue;
+        recorder_input(input);
+        if (input == ' ') {
+            paused.store(!paused.load());
+            set_message(paused.load() ? "【已暂停】按空格继续" : "【已继续】模拟运行中");
+        }
+        else if (is_speed_up_key(input)) {
+            int delay = delay_ms.load();
+            if (delay > 20) {
+                delay_ms.store(delay - 20);
+                set_message("速度加快");
+            }
+            else {
+                set_message(delay == 0 ? "已在全速运行（按 F 恢复）" : "已达到最快速度！按 F 全速运行");
+            }
+        }
+        else if (is_speed_down_key(input)) {
+            int delay = delay_ms.load();
+            delay_ms.store(delay == 0 ? saved_delay_ms : delay + 20);
+            set_message("速度减慢");
+        }
+        else if (input == 'f' || input == 'F') {
+            if (delay_ms.load() > 0) {
+                saved_delay_ms = delay_ms.load();
+                delay_ms.store(0);
+                set_message("全速运行：画面仍按固定帧率刷新");
             }
-            else if (is_speed_up_key(input)) {
-                if (delay_ms > 20) {
-                    delay_ms -= 20;
-                    set_message("速度加快");
-                }
-                else {
-                    set_message("已达到最快速度！");
-                }
+            else {
+                delay_ms.store(saved_delay_ms);
+                set_message("恢复正常速度");
             }
-            else if (is_speed_down_key(input)) {
-                delay_ms += 20;
-                set_message("速度减慢");
+        }
+        else if (input == 'p' || input == 'P') {
+            show_profile.store(!show_profile.load());
+        }
+        else if (input == 'd' || input == 'D') {
+            show_census.store(!show_census.load());
+        }
+        else if (input == '[' || input == ']') {
+            int zoom = history_zoom.load() + (input == ']' ? 1 : -1);
+            if (zoom >= 0 && zoom < HISTORY_ZOOMS) history_zoom.store(zoom);
+        }
+        else if (input == 'r' || input == 'R') {
+            pending_command.store('r');
+        }
+        else if (input == 's' || input == 'S') {
+            pending_command.store('s');
+        }
+        else if (input == 'q' || input == 'Q') {
+            quit_requested.store(1);
+        }
+    }
+}
+
+#ifndef _WIN32
+struct termios saved_termios;
+int termios_saved = 0;
+#endif
+
+// 交互会话开始时进入原始模式（不回显、不等回车），直到会话结束才恢复
+void term_raw_begin() {
+#ifndef _WIN32
+    if (tcgetattr(STDIN_FILENO, &saved_termios) != 0) return;
+    struct termios raw = saved_termios;
+    raw.c_lflag &= ~(ICANON | ECHO);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+    tcsetattr(STDIN_FILENO, TCSANOW, &raw);
+    termios_saved = 1;
+    atexit(term_raw_end);
+#endif
+}
+
+void term_raw_end() {
+#ifndef _WIN32
+    if (termios_saved) tcsetattr(STDIN_FILENO, TCSANOW, &saved_termios);
+    termios_saved = 0;
+#endif
+}
+
+// 最多等待 timeout_ms 毫秒读取一个按键，超时返回 -1
+int read_key(int timeout_ms) {
+#ifdef _WIN32
+    for (int waited = 0;; waited += 10) {
+        if (_kbhit()) return _getch();
+        if (waited >= timeout_ms) return -1;
+        Sleep(10);
+    }
+#else
+    struct pollfd pfd = { .fd = STDIN_FILENO, .events = POLLIN };
+    if (poll(&pfd, 1, timeout_ms) <= 0) return -1;
+    unsigned char c;
+    return read(STDIN_FILENO, &c, 1) == 1 ? c : -1;
+#endif
+}
+
+// 各物种的参数由特性表生成：--<key> 为初始数量，--<prefix>-breed、--<prefix>-breed-energy 为繁殖参数。
+// opt 是其中之一时设置对应的目标变量并返回 1
+int species_option(const char* opt, int** target, double** real_target) {
+    if (strncmp(opt, "--", 2) != 0) return 0;
+    opt += 2;
+    for (int s = 0; s < ANIMAL_SPECIES; s++) {
+        size_t n = strlen(SPECIES[s].prefix);
+        if (strcmp(opt, SPECIES[s].key) == 0) *target = &species_init[s];
+        else if (strncmp(opt, SPECIES[s].prefix, n) != 0) continue;
+        else if (strcmp(opt + n, "-breed") == 0) *real_target = &species_breed_prob[s];
+        else if (strcmp(opt + n, "-breed-energy") == 0) *target = &species_breed_energy[s];
+        else continue;
+        return 1;
+    }
+    return 0;
+}
+
+// 解析命令行参数。返回 1 继续运行，0 正常退出（如 --help），-1 参数错误
+int parse_args(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        const char* opt = argv[i];
+        if (strcmp(opt, "--batch") == 0 || strcmp(opt, "-b") == 0) {
+            batch_mode = 1;
+            continue;
+        }
+        if (strcmp(opt, "--csv") == 0) {
+            csv_output = 1;
+            continue;
+        }
+        if (strcmp(opt, "--census") == 0) {
+            census_report = 1;
+            continue;
+        }
+        if (strcmp(opt, "--grass-skip") == 0) {
+            grass_skip = 1;
+            continue;
+        }
+        if (strcmp(opt, "--validate") == 0) {
+            validate_surrogate = 1;
+            batch_mode = 1;
+            continue;
+        }
+        if (strcmp(opt, "--help") == 0 || strcmp(opt, "-h") == 0) {
+            print_usage(argv[0]);
+            return 0;
+        }
+        int* target = NULL;
+        double* real_target = NULL;
+        long min_val = 0, max_val = INT_MAX;
+        if (strcmp(opt, "--width") == 0) { target = &grid_w; min_val = 1; max_val = 65536; }
+        else if (strcmp(opt, "--height") == 0) { target = &grid_h; min_val = 1; max_val = 65536; }
+        else if (strcmp(opt, "--grass") == 0) target = &init_grass;
+        else if (strcmp(opt, "--season") == 0) { target = &start_season; max_val = 3; }
+        else if (strcmp(opt, "--ticks") == 0) target = &batch_ticks;
+        else if (strcmp(opt, "--threads") == 0) { target = &thread_count; max_val = 1024; }
+        else if (strcmp(opt, "--procs") == 0) { target = &process_count; min_val = 1; max_val = DOMAIN_MAX_PROCS; }
+        else if (strcmp(opt, "--replicates") == 0) { target = &sweep_replicates; min_val = 1; sweep_mode = 1; }
+        else if (strcmp(opt, "--jobs") == 0) { target = &sweep_jobs; max_val = 1024; }
+        else if (!species_option(opt, &target, &real_target) && strcmp(opt, "--seed") != 0 && strcmp(opt, "--sweep") != 0 && strcmp(opt, "--out") != 0
+            && strcmp(opt, "--resume") != 0 && strcmp(opt, "--checkpoint") != 0 && strcmp(opt, "--stats") != 0
+            && strcmp(opt, "--profile") != 0 && strcmp(opt, "--density") != 0 && strcmp(opt, "--surrogate") != 0
+            && strcmp(opt, "--fit-surrogate") != 0 && strcmp(opt, "--record") != 0 && strcmp(opt, "--replay") != 0
+            && strcmp(opt, "--telemetry") != 0) {
+            fprintf(stderr, "未知参数: %s\n", opt);
+            print_usage(argv[0]);
+            return -1;
+        }
+
+        if (i + 1 >= argc) {
+            fprintf(stderr, "参数 %s 缺少取值\n", opt);
+            return -1;
+        }
+        const char* arg = argv[++i];
+        char* end;
+        if (strcmp(opt, "--sweep") == 0) {
+            if (!add_sweep_axis(arg)) return -1;
+            continue;
+        }
+        if (strcmp(opt, "--out") == 0) {
+            sweep_out = arg;
+            continue;
+        }
+        if (strcmp(opt, "--resume") == 0) {
+            resume_path = arg;
+            continue;
+        }
+        if (strcmp(opt, "--checkpoint") == 0) {
+            checkpoint_path = arg;
+            continue;
+        }
+        if (strcmp(opt, "--surrogate") == 0) {
+            surrogate_path = arg;
+            continue;
+        }
+        if (strcmp(opt, "--fit-surrogate") == 0) {
+            fit_surrogate_path = arg;
+            batch_mode = 1;
+            continue;
+        }
+        if (strcmp(opt, "--record") == 0) {
+            record_path = arg;
+            continue;
+        }
+        if (strcmp(opt, "--replay") == 0) {
+            replay_path = arg;
+            continue;
+        }
+        if (strcmp(opt, "--stats") == 0) {
+            stats_path = arg;
+            continue;
+        }
+        if (strcmp(opt, "--profile") == 0) {
+            profile_path = arg;
+            continue;
+        }
+        if (strcmp(opt, "--density") == 0) {
+            density_path = arg;
+            continue;
+        }
+        if (strcmp(opt, "--telemetry") == 0) {
+            telemetry_spec = arg;
+            continue;
+        }
+        if (real_target != NULL) {
+            double val = strtod(arg, &end);
+            if (end == arg || *end != '\0' || val < 0.0 || val > 1.0) {
+                fprintf(stderr, "参数 %s 的取值无效: %s（范围 0~1）\n", opt, arg);
+                return -1;
             }
-            else if (input == 'r' || input == 'R') {
-                initialize_grid();
-                tick = 0;
-                set_message("生态系统已重置！");
+            *real_target = val;
+            continue;
+        }
+        if (target == NULL) {
+            unsigned long seed = strtoul(arg, &end, 10);
+            if (end == arg || *end != '\0') {
+                fprintf(stderr, "无效的随机种子: %s\n", arg);
+                return -1;
             }
-            else if (input == 's' || input == 'S') {
-                save_snapshot();
+            rand_seed = (unsigned int)seed;
+            continue;
+        }
+        long val = strtol(arg, &end, 10);
+        if (end == arg || *end != '\0' || val < min_val || val > max_val) {
+            fprintf(stderr, "参数 %s 的取值无效: %s（范围 %ld~%ld）\n", opt, arg, min_val, max_val);
+            return -1;
+        }
+        *target = (int)val;
+    }
+    if ((long long)grid_w * grid_h > INT_MAX) {
+        fprintf(stderr, "地图过大: %d x %d\n", grid_w, grid_h);
+        return -1;
+    }
+    return 1;
+}
+
+void print_usage(const char* prog) {
+    printf("用法: %s [选项]\n", prog);
+    printf("  --batch, -b        无界面批处理模式：不绘制、不等待，结束时只输出统计\n");
+    printf("  --width N          地图宽度（列数，默认 %d）\n", DEFAULT_GRID_SIZE);
+    printf("  --height N         地图高度（行数，默认 %d）\n", DEFAULT_GRID_SIZE);
+    printf("  --grass N          初始青草数量（默认 %d）\n", init_grass);
+    char name[64];
+    for (int s = 0; s < ANIMAL_SPECIES; s++) {
+        snprintf(name, sizeof(name), "--%s N", SPECIES[s].key);
+        printf("  %-18s 初始%s数量（默认 %d）\n", name, SPECIES[s].name, species_init[s]);
+    }
+    printf("  --season 0-3       起始季节：0=春 1=夏 2=秋 3=冬（默认 0）\n");
+    printf("  --seed N           随机种子，相同种子结果完全一致（默认取当前时间）\n");
+    printf("  --ticks N          批处理模式下模拟的回合数（默认 %d）\n", batch_ticks);
+    printf("  --threads N        模拟使用的线程数（默认 0=全部核心，结果与线程数无关）\n");
+    printf("  --procs N          批处理时把地图按条带分给 N 个进程，经共享内存交换边界（结果与单进程相同）\n");
+    for (int s = 0; s < ANIMAL_SPECIES; s++) {
+        snprintf(name, sizeof(name), "--%s-breed P", SPECIES[s].prefix);
+        printf("  %-18s %s每回合的繁殖概率（默认 %.2f）\n", name, SPECIES[s].name, species_breed_prob[s]);
+        snprintf(name, sizeof(name), "--%s-breed-energy N", SPECIES[s].prefix);
+        printf("  %-24s %s繁殖所需的最低能量（默认 %d）\n", name, SPECIES[s].name, species_breed_energy[s]);
+    }
+    printf("  --density 文件     按密度图放置初始的青草和动物（每种类型一张粗网格，拉伸覆盖地图，见 README）\n");
+    printf("  --grass-skip       青草按几何跳跃抽样：分布不变，随机数抽样次数少得多（与默认方式的结果不同）\n");
+    printf("  --csv              批处理结果以 CSV 输出（表头一行 + 数据一行）\n");
+    printf("  --census           批处理结束时输出各物种的能量、年龄分布和动物最多的区块\n");
+    printf("  --sweep 名称=值,值  参数扫描的一维，可重复；名称为上面取数值的参数（不带 --）\n");
+    printf("  --replicates N     参数扫描中每组参数重复的次数，种子依次为 seed, seed+1, ...（默认 1）\n");
+    printf("  --jobs N           参数扫描同时运行的模拟数（默认 0=全部核心）\n");
+    printf("  --out 文件         参数扫描的汇总表（CSV），默认输出到屏幕\n");
+    printf("  --resume 文件      从二进制存档继续（地图、个体、统计和随机数状态完整恢复）\n");
+    printf("  --checkpoint 文件  批处理结束时把完整状态写入二进制存档\n");
+    printf("  --stats 文件       把每回合的数量和出生/死亡/捕食事件写入文件（.bin 为二进制，否则为 CSV）\n");
+    printf("  --telemetry 端口|路径  在 127.0.0.1 的端口（或 Unix 套接字）上以 JSON 提供当前回合、数量、速度和各阶段用时\n");
+    printf("  --profile 文件     退出时把各阶段用时和事件计数写入 JSON（需编译时定义 ECO_PROFILE）\n");
+    printf("  --fit-surrogate 文件  批处理的同时用每回合的数量拟合平均场替代模型，结束时写入文件\n");
+    printf("  --surrogate 文件   用拟合好的替代模型代替逐格模拟，只推进三种数量（可用于参数扫描）\n");
+    printf("  --validate         与 --surrogate 一起使用：照常模拟，报告替代模型相对模拟的偏差\n");
+    printf("  --record 文件      把每回合的画面（只存变化的格子）、种子、参数和按键录制到文件\n");
+    printf("  --replay 文件      回放录制文件：可暂停、倒放、单帧和跳转，不重新模拟；与 --batch 一起使用时测试解码速度\n");
+    printf("  --help, -h         显示本帮助\n");
+}
+
+// 批处理模式：连续推进 update_grass()/update_entities()，不绘制也不休眠
+int run_batch() {
+    // 先分出子进程再生成世界：分叉之前运行过 OpenMP 并行区的话，子进程里的线程池已经失效，
+    // 再进入并行区就会卡住。世界的生成与线程数无关，各进程各自生成的世界逐位相同；读档不用并行区
+    if (!domain_start(process_count)) return 1;
+    if (!resume_path) initialize_grid();
+#ifdef _OPENMP
+    if (process_count > 1 && thread_count == 0) {
+        int per_process = omp_get_num_procs() / process_count;
+        omp_set_num_threads(per_process > 1 ? per_process : 1);
+    }
+#endif
+    if (!start_recording()) return 1;
+    // 监控端点在分出子进程之后由主进程打开，子进程不继承它的线程和套接字
+    if (telemetry_spec && process_rank == 0 && !telemetry_start(telemetry_spec)) return 1;
+    int start_tick = tick;
+    double cells = (double)grid_w * grid_h;
+    SurrogateFit* fit = NULL;
+    if (fit_surrogate_path && (fit = (SurrogateFit*)calloc(1, sizeof(SurrogateFit))) == NULL) {
+        fprintf(stderr, "内存不足，无法拟合替代模型\n");
+        return 1;
+    }
+    // 替代模型从同样的数量出发独立推进，不回看模拟的结果；记录偏差和若干回合的对照
+    const int rabbit = SPECIES_OF(RABBIT), wolf = SPECIES_OF(WOLF);
+    SurrogateState before = { (double)grass_count, (double)species_count[rabbit], (double)species_count[wolf] };
+    SurrogateState predicted = before;
+    SurrogateState start_state = before;
+    double drift_sq[3] = { 0 }, drift_max[3] = { 0 };
+    ValidateRow rows[VALIDATE_ROWS];
+    int row_count = 0;
+    int row_every = (batch_ticks - start_tick) / VALIDATE_ROWS > 0 ? (batch_ticks - start_tick) / VALIDATE_ROWS : 1;
+
+    double start = now_seconds();
+    while (tick < batch_ticks) {
+        double t0 = now_seconds();
+        update_season();
+        update_grass();
+        double t1 = now_seconds();
+        update_entities();
+        double t2 = now_seconds();
+        if (!domain_exchange()) {
+            free(fit);
+            return 1;
+        }
+        double t3 = now_seconds();
+        record_tick_stats();
+        SurrogateState after = { (double)grass_count, (double)species_count[rabbit], (double)species_count[wolf] };
+        if (fit) surrogate_fit_add(fit, season, cells, &before, &after);
+        if (validate_surrogate) {
+            surrogate_step(&surrogate_model, season, cells, &predicted);
+            const double diff[3] = { predicted.grass - after.grass, predicted.rabbits - after.rabbits, predicted.wolves - after.wolves };
+            for (int k = 0; k < 3; k++) {
+                drift_sq[k] += diff[k] * diff[k];
+                if (fabs(diff[k]) > drift_max[k]) drift_max[k] = fabs(diff[k]);
             }
-            else if (input == 'q' || input == 'Q') {
-                clear_screen();
-                printf("\n感谢使用生态系统模拟器！\n");
-                printf("  草按季节再生 | 起始季节: %s\n", season_names[start_season]);
-                printf("食物链：青草 -> 兔子 -> 狼\n\n");
-                return 0;
+            if ((tick + 1 - start_tick) % row_every == 0 && row_count < VALIDATE_ROWS) {
+                rows[row_count].tick = tick + 1;
+                rows[row_count].agent = after;
+                rows[row_count].model = predicted;
+                row_count++;
             }
-            else {
-                handled = 0;
+        }
+        before = after;
+        tick++;
+        recorder_frame();
+        const double phases[TELE_PHASES] = { t1 - t0, t2 - t1, t3 - t2, now_seconds() - t3 };
+        telemetry_publish(phases, 0);
+    }
+    double elapsed = now_seconds() - start;
+    telemetry_publish(NULL, 1);
+    if (!domain_finish()) {
+        free(fit);
+        return 1;
+    }
+    update_season();
+    if (checkpoint_path && !save_checkpoint(checkpoint_path)) {
+        fprintf(stderr, "无法写入存档: %s\n", checkpoint_path);
+        free(fit);
+        return 1;
+    }
+    BatchSummary summary;
+    summarize_run(&summary);
+    if (csv_output) print_summary(&summary, tick, elapsed);
+    else {
+        printf("地图: %d x %d | 随机种子: %u | 起始季节: %s\n",
+            grid_w, grid_h, rand_seed, season_names[start_season]);
+        printf("回合: %d | 季节: %s\n", tick, season_names[season]);
+        print_summary(&summary, tick, elapsed);
+        printf("耗时: %.3f 秒 | %.1f 回合/秒 | 已分配区块: %d/%d\n",
+            elapsed, elapsed > 0 ? (tick - start_tick) / elapsed : 0.0, chunks_allocated, chunk_count);
+    }
+
+    // 结果在 CSV 模式下只占标准输出的两行，拟合与验证的报告改写到标准错误
+    FILE* report = csv_output ? stderr : stdout;
+    if (census_report) {
+        if (densest_tile < 0) fprintf(report, "分布: 地图上没有动物\n");
+        else fprintf(report, "分布: 动物最多的区块 (%dx%d) 为第 %d 行第 %d 列，%d 只\n", CHUNK_SIZE, CHUNK_SIZE,
+            densest_tile / plane_words, densest_tile % plane_words, densest_animals);
+        for (int s = 0; s < ANIMAL_SPECIES; s++) {
+            const SpeciesCensus* c = &census[s];
+            if (c->count == 0) continue;
+            fprintf(report, "  %s: %d 只 | 平均能量 %.2f | 平均年龄 %.2f\n", SPECIES[s].name, c->count,
+                (double)c->energy_sum / c->count, (double)c->age_sum / c->count);
+            fprintf(report, "    能量（每组 %d）:", CENSUS_ENERGY_STEP);
+            for (int k = 0; k < CENSUS_BINS; k++) fprintf(report, " %d", c->energy[k]);
+            fprintf(report, "\n    年龄（每组 %d）:", CENSUS_AGE_STEP);
+            for (int k = 0; k < CENSUS_BINS; k++) fprintf(report, " %d", c->age[k]);
+            fprintf(report, "\n");
+        }
+    }
+    if (fit) {
+        SurrogateModel model;
+        int seasons = surrogate_fit_solve(fit, &model);
+        free(fit);
+        if (!surrogate_save(fit_surrogate_path, &model)) {
+            fprintf(stderr, "无法写入替代模型: %s\n", fit_surrogate_path);
+            return 1;
+        }
+        fprintf(report, "替代模型已写入 %s（%d 个季节有样本）\n", fit_surrogate_path, seasons);
+        for (int s = 0; s < 4; s++) {
+            if (model.samples[s] == 0) continue;
+            fprintf(report, "  %s: %lld 回合 | 决定系数 (草/兔/狼): %.3f/%.3f/%.3f\n", season_names[s],
+                model.samples[s], model.r2[s][0], model.r2[s][1], model.r2[s][2]);
+        }
+        if (seasons < 4) fprintf(report, "  没有样本的季节系数为 0，替代模型在这些季节中数量不变；可增加 --ticks 覆盖全部四季\n");
+    }
+    if (validate_surrogate) {
+        int n = tick - start_tick;
+        SurrogateResult res;
+        double t0 = now_seconds();
+        surrogate_run(&surrogate_model, cells, start_tick, tick, &start_state, &res);
+        double model_elapsed = now_seconds() - t0;
+        const double mean[3] = { summary.mean_grass, summary.means[rabbit], summary.means[wolf] };
+        double rms[3];
+        for (int k = 0; k < 3; k++) rms[k] = n ? sqrt(drift_sq[k] / n) : 0.0;
+        fprintf(report, "替代模型验证（%s，同样的初始数量与起始季节）:\n", surrogate_path);
+        fprintf(report, "      回合 |     青草 模拟/替代 |     兔子 模拟/替代 |       狼 模拟/替代\n");
+        for (int k = 0; k < row_count; k++) {
+            const ValidateRow* row = &rows[k];
+            fprintf(report, "  %8d | %8.0f/%-9.0f | %8.0f/%-9.0f | %8.0f/%-9.0f\n", row->tick,
+                row->agent.grass, row->model.grass, row->agent.rabbits, row->model.rabbits,
+                row->agent.wolves, row->model.wolves);
+        }
+        fprintf(report, "均方根偏差 (草/兔/狼): %.1f/%.1f/%.1f（为模拟平均数量的 %.1f%%/%.1f%%/%.1f%%）\n",
+            rms[0], rms[1], rms[2], mean[0] > 0 ? 100.0 * rms[0] / mean[0] : 0.0,
+            mean[1] > 0 ? 100.0 * rms[1] / mean[1] : 0.0, mean[2] > 0 ? 100.0 * rms[2] / mean[2] : 0.0);
+        fprintf(report, "最大偏差 (草/兔/狼): %.0f/%.0f/%.0f | 灭绝回合 (兔/狼): 模拟 %d/%d，替代 %d/%d\n",
+            drift_max[0], drift_max[1], drift_max[2], species_extinct_tick[rabbit], species_extinct_tick[wolf],
+            res.rabbit_extinct_tick, res.wolf_extinct_tick);
+        fprintf(report, "耗时: 模拟 %.3f 秒，替代模型 %.3f 毫秒\n", elapsed, model_elapsed * 1e3);
+    }
+
+    return 0;
+}
+
+// 整次运行的统计：当前数量、峰谷值、灭绝回合与平均数量
+void summarize_run(BatchSummary* sum) {
+    sum->grass = grass_count;
+    sum->mean_grass = stat_ticks ? (double)sum_grass / stat_ticks : 0.0;
+    for (int s = 0; s < ANIMAL_SPECIES; s++) {
+        sum->counts[s] = species_count[s];
+        sum->max_counts[s] = species_max[s];
+        sum->min_counts[s] = species_min[s] == INT_MAX ? 0 : species_min[s];
+        sum->extinct_ticks[s] = species_extinct_tick[s];
+        sum->means[s] = stat_ticks ? (double)species_sum[s] / stat_ticks : 0.0;
+    }
+}
+
+// 输出批处理的统计：CSV 模式下为表头一行 + 数据一行，各物种的列按特性表依次展开（<key>、max_<key>、
+// min_<key>、<prefix>_extinct_tick、mean_<key>），parse_summary_csv 按同样的顺序解析；否则为几行文字
+void print_summary(const BatchSummary* sum, int ticks, double seconds) {
+    if (csv_output) {
+        printf("seed,ticks,grass");
+        for (int s = 0; s < ANIMAL_SPECIES; s++) printf(",%s", SPECIES[s].key);
+        for (int s = 0; s < ANIMAL_SPECIES; s++) printf(",max_%s", SPECIES[s].key);
+        for (int s = 0; s < ANIMAL_SPECIES; s++) printf(",min_%s", SPECIES[s].key);
+        for (int s = 0; s < ANIMAL_SPECIES; s++) printf(",%s_extinct_tick", SPECIES[s].prefix);
+        for (int s = 0; s < ANIMAL_SPECIES; s++) printf(",mean_%s", SPECIES[s].key);
+        printf(",mean_grass,seconds\n");
+        printf("%u,%d,%.0f", rand_seed, ticks, sum->grass);
+        for (int s = 0; s < ANIMAL_SPECIES; s++) printf(",%.0f", sum->counts[s]);
+        for (int s = 0; s < ANIMAL_SPECIES; s++) printf(",%.0f", sum->max_counts[s]);
+        for (int s = 0; s < ANIMAL_SPECIES; s++) printf(",%.0f", sum->min_counts[s]);
+        for (int s = 0; s < ANIMAL_SPECIES; s++) printf(",%d", sum->extinct_ticks[s]);
+        for (int s = 0; s < ANIMAL_SPECIES; s++) printf(",%.3f", sum->means[s]);
+        printf(",%.3f,%.6f\n", sum->mean_grass, seconds);
+        return;
+    }
+    printf("青草: %.0f", sum->grass);
+    for (int s = 0; s < ANIMAL_SPECIES; s++) printf(" | %s: %.0f", SPECIES[s].name, sum->counts[s]);
+    printf("\n历史峰值/谷值:");
+    for (int s = 0; s < ANIMAL_SPECIES; s++)
+        printf("%s %s %.0f/%.0f", s ? " |" : "", SPECIES[s].name, sum->max_counts[s], sum->min_counts[s]);
+    printf("\n灭绝回合（-1 表示未灭绝）:");
+    for (int s = 0; s < ANIMAL_SPECIES; s++) printf("%s %s %d", s ? " |" : "", SPECIES[s].name, sum->extinct_ticks[s]);
+    printf("\n平均数量: 青草 %.1f", sum->mean_grass);
+    for (int s = 0; s < ANIMAL_SPECIES; s++) printf(" | %s %.1f", SPECIES[s].name, sum->means[s]);
+    printf("\n");
+}
+
+// 解析 print_summary 输出的 CSV 数据行，表头和其他不是这一格式的行返回 0
+int parse_summary_csv(const char* line, BatchSummary* sum) {
+    const int fields = 5 + 5 * ANIMAL_SPECIES;
+    double v[5 + 5 * ANIMAL_SPECIES];
+    const char* p = line;
+    char* end;
+    int n = 0;
+    for (;;) {
+        v[n++] = strtod(p, &end);
+        if (end == p || *end != ',' || n == fields) break;
+        p = end + 1;
+    }
+    if (end == p || n != fields || (*end != '\0' && *end != '\n' && *end != '\r')) return 0;
+    sum->grass = v[2];
+    for (int s = 0; s < ANIMAL_SPECIES; s++) {
+        sum->counts[s] = v[3 + s];
+        sum->max_counts[s] = v[3 + ANIMAL_SPECIES + s];
+        sum->min_counts[s] = v[3 + 2 * ANIMAL_SPECIES + s];
+        sum->extinct_ticks[s] = (int)v[3 + 3 * ANIMAL_SPECIES + s];
+        sum->means[s] = v[3 + 4 * ANIMAL_SPECIES + s];
+    }
+    sum->mean_grass = v[3 + 5 * ANIMAL_SPECIES];
+    return 1;
+}
+
+// 只用替代模型推进 batch_ticks 回合，输出与批处理相同的统计（数量取整）。
+// 替代模型只含青草、兔子和狼，其余物种记为从未出现（第 0 回合灭绝）
+int run_surrogate() {
+    const int rabbit = SPECIES_OF(RABBIT), wolf = SPECIES_OF(WOLF);
+    double cells = (double)grid_w * grid_h;
+    SurrogateState s;
+    s.grass = init_grass < cells ? init_grass : cells;
+    s.rabbits = species_init[rabbit] < cells - s.grass ? species_init[rabbit] : cells - s.grass;
+    s.wolves = species_init[wolf] < cells - s.grass - s.rabbits ? species_init[wolf] : cells - s.grass - s.rabbits;
+    SurrogateResult res;
+    double start = now_seconds();
+    surrogate_run(&surrogate_model, cells, 0, batch_ticks, &s, &res);
+    double elapsed = now_seconds() - start;
+
+    int ticks = res.stat_ticks;
+    BatchSummary summary;
+    memset(&summary, 0, sizeof(summary));
+    summary.grass = res.last.grass;
+    summary.mean_grass = ticks ? res.sum_grass / ticks : 0.0;
+    summary.counts[rabbit] = res.last.rabbits;
+    summary.counts[wolf] = res.last.wolves;
+    summary.max_counts[rabbit] = res.max_rabbits;
+    summary.max_counts[wolf] = res.max_wolves;
+    summary.min_counts[rabbit] = res.min_rabbits;
+    summary.min_counts[wolf] = res.min_wolves;
+    summary.extinct_ticks[rabbit] = res.rabbit_extinct_tick;
+    summary.extinct_ticks[wolf] = res.wolf_extinct_tick;
+    summary.means[rabbit] = ticks ? res.sum_rabbits / ticks : 0.0;
+    summary.means[wolf] = ticks ? res.sum_wolves / ticks : 0.0;
+    if (csv_output) {
+        print_summary(&summary, batch_ticks, elapsed);
+        return 0;
+    }
+
+    printf("替代模型: %s | 地图: %d x %d | 起始季节: %s\n",
+        surrogate_path, grid_w, grid_h, season_names[start_season]);
+    printf("回合: %d | 季节: %s\n", batch_ticks, season_names[season_at(batch_ticks)]);
+    print_summary(&summary, batch_ticks, elapsed);
+    printf("耗时: %.3f 毫秒 | %.0f 回合/秒\n", elapsed * 1e3, elapsed > 0 ? batch_ticks / elapsed : 0.0);
+    return 0;
+}
+
+// 按 --record 开始录制并记下第 0 帧（当前世界）；没有要求录制时直接返回 1
+int start_recording() {
+    if (!record_path) return 1;
+    if (!recorder_open(record_path)) {
+        fprintf(stderr, "无法创建录制文件: %s\n", record_path);
+        return 0;
+    }
+    recorder_frame();
+    return 1;
+}
+
+// 画面的 64 位 FNV-1a 散列，用于检查正放与倒放解码出的画面一致
+static unsigned long long glyph_hash(const unsigned char* g, int n) {
+    unsigned long long h = 1469598103934665603ULL;
+    for (int k = 0; k < n; k++) h = (h ^ g[k]) * 1099511628211ULL;
+    return h;
+}
+
+static void key_name(int key, char* out) {
+    if (key == ' ') strcpy(out, "空格");
+    else if (key > ' ' && key < 127) sprintf(out, "%c", key);
+    else sprintf(out, "#%d", key);
+}
+
+// 批处理回放：依次正放、倒放全部帧，再随机跳转，报告各自的速度，并核对三种方式解码出的画面
+static int replay_benchmark(Replay* rp) {
+    int frames = rp->frames;
+    unsigned long long* hashes = (unsigned long long*)malloc(sizeof(unsigned long long) * frames);
+    if (!hashes) {
+        fprintf(stderr, "内存不足\n");
+        return 1;
+    }
+    int ok = 1, mismatches = 0;
+    double t0 = now_seconds();
+    for (int f = 0; ok && f < frames; f++) ok = replay_seek(rp, f);
+    double forward = now_seconds() - t0;
+    for (int f = 0; ok && f < frames; f++) {
+        ok = replay_seek(rp, f);
+        hashes[f] = glyph_hash(rp->glyphs, rp->cells);
+    }
+    t0 = now_seconds();
+    for (int f = frames - 1; ok && f >= 0; f--) ok = replay_seek(rp, f);
+    double backward = now_seconds() - t0;
+    replay_seek(rp, frames - 1);
+    for (int f = frames - 1; ok && f >= 0; f--) {
+        ok = replay_seek(rp, f);
+        if (glyph_hash(rp->glyphs, rp->cells) != hashes[f]) mismatches++;
+    }
+    int seeks = frames < 1000 ? frames : 1000;
+    unsigned long long x = 12345;
+    t0 = now_seconds();
+    for (int k = 0; ok && k < seeks; k++) {
+        x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+        ok = replay_seek(rp, (int)((x >> 33) % (unsigned long long)frames));
+    }
+    double jump = now_seconds() - t0;
+    for (int k = 0; ok && k < seeks; k++) {
+        x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+        int f = (int)((x >> 33) % (unsigned long long)frames);
+        ok = replay_seek(rp, f);
+        if (glyph_hash(rp->glyphs, rp->cells) != hashes[f]) mismatches++;
+    }
+    free(hashes);
+    if (!ok) {
+        fprintf(stderr, "录制文件已损坏：解码第 %d 帧附近时出错\n", rp->current);
+        return 1;
+    }
+    printf("录制: %s | 地图: %d x %d | 帧: %d | 关键帧: %d | 按键: %d | 文件: %.1f KB（平均每帧 %.0f 字节）\n",
+        replay_path, rp->header.grid_w, rp->header.grid_h, frames, rp->keys, rp->inputs,
+        rp->size / 1024.0, (double)rp->size / frames);
+    printf("正放: %.0f 帧/秒 | 倒放: %.0f 帧/秒 | 随机跳转: %.0f 次/秒\n",
+        forward > 0 ? frames / forward : 0.0, backward > 0 ? frames / backward : 0.0, jump > 0 ? seeks / jump : 0.0);
+    printf("正放、倒放与跳转解码的画面%s\n", mismatches ? "不一致！" : "一致");
+    return mismatches ? 1 : 0;
+}
+
+// 回放模式：不分配世界，只解码录制的画面，渲染与交互模式共用。单线程：
+// 每个渲染帧之间读取按键，播放时按速度推进帧号，远距离跳转由 replay_seek 从关键帧解码
+int run_replay() {
+    Replay rp;
+    if (!replay_open(&rp, replay_path)) return 1;
+    grid_w = rp.header.grid_w;
+    grid_h = rp.header.grid_h;
+    if (batch_mode) {
+        int ret = replay_benchmark(&rp);
+        replay_close(&rp);
+        return ret;
+    }
+    view.glyphs = (unsigned char*)malloc(rp.cells);
+    if (!view.glyphs) {
+        fprintf(stderr, "内存不足：无法分配画面缓冲区\n");
+        replay_close(&rp);
+        return 1;
+    }
+    view.cells = rp.cells;
+
+    double pos = 0;
+    int playing = 1, dir = 1, fps = 8, quit = 0;
+    term_raw_begin();
+    render_invalidate();
+    double next_frame = now_seconds();
+    while (!quit) {
+        double wait = next_frame - now_seconds();
+        int input = read_key(wait > 0 ? (int)(wait * 1000) + 1 : 0);
+        char msg[128] = { 0 };
+        int last = rp.frames - 1;
+        if (input == ' ') {
+            if (!playing && dir > 0 && (int)pos == last) pos = 0;
+            if (!playing && dir < 0 && (int)pos == 0) pos = last;
+            playing = !playing;
+            strcpy(msg, playing ? "【播放】" : "【已暂停】按空格继续");
+        }
+        else if (is_speed_up_key(input) || is_speed_down_key(input)) {
+            fps = is_speed_up_key(input) ? (fps * 2 < REPLAY_MAX_FPS ? fps * 2 : REPLAY_MAX_FPS) : (fps > 1 ? fps / 2 : 1);
+            sprintf(msg, "回放速度: %d 帧/秒", fps);
+        }
+        else if (input == 'b' || input == 'B') {
+            dir = -dir;
+            strcpy(msg, dir > 0 ? "正放" : "倒放");
+        }
+        else if (input == ',' || input == '.') {
+            playing = 0;
+            pos = (int)pos + (input == '.' ? 1 : -1);
+        }
+        else if (input >= '0' && input <= '9') {
+            pos = (double)last * (input - '0') / 10;
+        }
+        else if (input == 'e' || input == 'E') {
+            pos = last;
+        }
+        else if (input == '[' || input == ']') {
+            int zoom = history_zoom.load() + (input == ']' ? 1 : -1);
+            if (zoom >= 0 && zoom < HISTORY_ZOOMS) history_zoom.store(zoom);
+        }
+        else if (input == 'q' || input == 'Q') {
+            quit = 1;
+        }
+        if (msg[0]) set_message(msg);
+        if (input >= 0 && now_seconds() < next_frame) continue;
+
+        next_frame += 1.0 / RENDER_FPS;
+        if (next_frame < now_seconds()) next_frame = now_seconds();
+        if (playing) {
+            pos += (double)dir * fps / RENDER_FPS;
+            if (pos <= 0 || pos >= last) {
+                pos = pos <= 0 ? 0 : last;
+                playing = 0;
+                set_message(pos == 0 ? "已回到开头" : "已播放到末尾");
             }
         }
+        if (pos < 0) pos = 0;
+        if (pos > last) pos = last;
+        if (!replay_seek(&rp, (int)pos)) {
+            term_raw_end();
+            render_free();
+            fprintf(stderr, "\n录制文件已损坏：无法解码第 %d 帧\n", (int)pos);
+            replay_close(&rp);
+            return 1;
+        }
 
-        if (!paused) {
-            usleep(delay_ms * 1000);
+        std::lock_guard<std::mutex> lock(view_mutex);
+        const FrameInfo* info = &rp.info;
+        memcpy(view.glyphs, rp.glyphs, rp.cells);
+        view.tick = info->tick;
+        view.season = info->season;
+        view.grass = info->grass;
+        memcpy(view.counts, info->counts, sizeof(view.counts));
+        memcpy(view.max_counts, info->max_counts, sizeof(view.max_counts));
+        memcpy(view.min_counts, info->min_counts, sizeof(view.min_counts));
+        view.seed = info->seed;
+        int window = history_zoom_ticks[history_zoom.load()];
+        view.chart_to = rp.current + 1;
+        view.chart_from = window > 0 ? view.chart_to - window : 0;
+        replay_chart(&rp, view.chart_from, view.chart_to, HISTORY_CHART_WIDTH, view.chart);
+        char pressed[64] = { 0 };
+        int k = replay_last_input(&rp, rp.current);
+        if (k >= 0) {
+            char name[16];
+            key_name(rp.input_keys[k], name);
+            snprintf(pressed, sizeof(pressed), " | 最近按键: %s（第 %d 帧前）", name, rp.input_frames[k]);
         }
+        snprintf(view.replay_status, TEXT_LINE_SIZE, "【回放】第 %d/%d 帧 | %s %d 帧/秒 | %s | 随机种子: %u%s",
+            rp.current, last, dir > 0 ? "正放" : "倒放", fps, playing ? "播放中" : "【已暂停】", info->seed, pressed);
+        view.serial++;
+        render_frame();
     }
+    term_raw_end();
+    render_free();
+    clear_screen();
+    printf("\n回放结束：%s，共 %d 帧（%d 个关键帧，%d 次按键）\n", replay_path, rp.frames, rp.keys, rp.inputs);
+    replay_close(&rp);
+    free(view.glyphs);
+    view.glyphs = NULL;
     return 0;
 }
 
-void set_message(const char* msg) {
-    strncpy(message, msg, sizeof(message) - 1);
-    message[sizeof(message) - 1] = '\0';
-    message_timeout = 30;
+// 解析 --sweep 名称=值1,值2,...；名称必须是取数值的模拟参数（固定的几个，或由特性表生成的物种参数），
+// 每个取值在这里就检查为数字，子进程再按各参数自己的范围检查
+int add_sweep_axis(const char* spec) {
+    static const char* fixed[] = { "width", "height", "grass", "season", "ticks" };
+    const char* eq = strchr(spec, '=');
+    int name_len = eq ? (int)(eq - spec) : 0;
+    char opt[40];
+    int known = 0, real = 0;
+    if (name_len > 0 && name_len + 3 <= (int)sizeof(opt)) {
+        snprintf(opt, sizeof(opt), "--%.*s", name_len, spec);
+        for (int k = 0; k < (int)(sizeof(fixed) / sizeof(fixed[0])); k++) {
+            if (strcmp(opt + 2, fixed[k]) == 0) known = 1;
+        }
+        int* target = NULL;
+        double* real_target = NULL;
+        if (!known && species_option(opt, &target, &real_target)) {
+            known = 1;
+            real = real_target != NULL;
+        }
+    }
+    if (!known || eq[1] == '\0') {
+        fprintf(stderr, "无效的扫描维度: %s（格式 名称=值1,值2,...）\n", spec);
+        return 0;
+    }
+    if (sweep_axis_count == MAX_SWEEP_AXES) {
+        fprintf(stderr, "扫描维度过多（最多 %d 维）\n", MAX_SWEEP_AXES);
+        return 0;
+    }
+
+    SweepAxis* axis = &sweep_axes[sweep_axis_count++];
+    memcpy(axis->name, spec, name_len);
+    axis->name[name_len] = '\0';
+    axis->count = 0;
+    char* values = (char*)malloc(strlen(eq + 1) + 1); // 取值列表在整个运行期间有效，不释放
+    if (!values) return 0;
+    strcpy(values, eq + 1);
+    for (char* v = strtok(values, ","); v != NULL; v = strtok(NULL, ",")) {
+        if (axis->count == MAX_SWEEP_VALUES) {
+            fprintf(stderr, "扫描维度 %s 的取值过多（最多 %d 个）\n", axis->name, MAX_SWEEP_VALUES);
+            return 0;
+        }
+        // 整数参数只接受十进制非负整数，概率只接受 0~1 的小数
+        char* end;
+        int valid;
+        if (real) {
+            double val = strtod(v, &end);
+            valid = end != v && *end == '\0' && val >= 0.0 && val <= 1.0;
+        }
+        else {
+            long val = strtol(v, &end, 10);
+            valid = end != v && *end == '\0' && val >= 0 && val <= INT_MAX;
+        }
+        if (!valid) {
+            fprintf(stderr, "扫描维度 %s 的取值无效: %s（应为%s）\n", axis->name, v,
+                real ? " 0~1 之间的数" : "非负整数");
+            return 0;
+        }
+        axis->values[axis->count++] = v;
+    }
+    sweep_mode = 1;
+    return 1;
+}
+
+// 一次子进程模拟的结果
+typedef struct {
+    int ok;
+    BatchSummary summary;
+} SweepResult;
+
+// 子进程的参数表：argv 依次指向 text 中的各个参数，末尾为 NULL
+typedef struct {
+    char* argv[64];
+    int argc;
+    char text[2048];
+    int used;
+    int overflow;
+} ArgList;
+
+void arg_add(ArgList* args, const char* fmt, ...) {
+    if (args->argc + 1 >= (int)(sizeof(args->argv) / sizeof(args->argv[0]))) {
+        args->overflow = 1;
+        return;
+    }
+    va_list ap;
+    va_start(ap, fmt);
+    int len = vsnprintf(args->text + args->used, sizeof(args->text) - args->used, fmt, ap);
+    va_end(ap);
+    if (len < 0 || args->used + len + 1 > (int)sizeof(args->text)) {
+        args->overflow = 1;
+        return;
+    }
+    args->argv[args->argc++] = args->text + args->used;
+    args->argv[args->argc] = NULL;
+    args->used += len + 1;
+}
+
+// 启动一次模拟并逐行解析它输出的 CSV，返回子进程是否正常结束。
+// POSIX 下用 posix_spawnp 直接传参数表，不经过 shell；
+// Windows 的 _popen 总要经过 cmd.exe，每个参数加引号，含引号或 % 的参数直接拒绝
+int run_child(const ArgList* args, SweepResult* res) {
+    FILE* p = NULL;
+#ifdef _WIN32
+    char cmd[4096];
+    int len = 1;
+    cmd[0] = '"'; // cmd.exe 会去掉整条命令两端的引号
+    for (int i = 0; i < args->argc; i++) {
+        if (strpbrk(args->argv[i], "\"%") != NULL) return 0;
+        int n = snprintf(cmd + len, sizeof(cmd) - len, i ? " \"%s\"" : "\"%s\"", args->argv[i]);
+        if (n < 0 || len + n + 2 > (int)sizeof(cmd)) return 0;
+        len += n;
+    }
+    strcpy(cmd + len, "\"");
+    p = _popen(cmd, "r");
+    if (!p) return 0;
+#else
+    int fds[2];
+    pid_t pid;
+    int spawned;
+    // 各工作线程同时启动子进程：管道设为 close-on-exec，并串行创建，
+    // 以免一个子进程继承别的子进程管道的写端，让对方读不到文件结束
+#pragma omp critical(sweep_spawn)
+    {
+        spawned = 0;
+        if (pipe(fds) == 0) {
+            fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+            fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+            posix_spawn_file_actions_t actions;
+            posix_spawn_file_actions_init(&actions);
+            posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO);
+            spawned = posix_spawnp(&pid, args->argv[0], &actions, NULL, args->argv, environ) == 0;
+            posix_spawn_file_actions_destroy(&actions);
+            close(fds[1]);
+            if (!spawned) close(fds[0]);
+        }
+    }
+    if (!spawned) return 0;
+    p = fdopen(fds[0], "r");
+    if (!p) {
+        close(fds[0]);
+        waitpid(pid, NULL, 0);
+        return 0;
+    }
+#endif
+
+    char line[1024];
+    int parsed = 0;
+    while (fgets(line, sizeof(line), p) != NULL) {
+        if (parse_summary_csv(line, &res->summary)) parsed = 1;
+    }
+#ifdef _WIN32
+    return _pclose(p) == 0 && parsed;
+#else
+    fclose(p);
+    int status;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) return 0;
+    }
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0 && parsed;
+#endif
+}
+
+// 参数扫描：所有 (参数组合, 重复) 组成任务表，由工作线程各自启动子进程领取执行；
+// 每个子进程单线程运行，互不共享状态。结果按参数组合汇总为一张 CSV 表
+int run_sweep() {
+    int points = 1;
+    for (int a = 0; a < sweep_axis_count; a++) points *= sweep_axes[a].count;
+    int runs = points * sweep_replicates;
+    SweepResult* results = (SweepResult*)calloc(runs, sizeof(SweepResult));
+    if (!results) {
+        fprintf(stderr, "内存不足：无法记录 %d 次模拟的结果\n", runs);
+        return 1;
+    }
+    FILE* out = sweep_out ? fopen(sweep_out, "w") : stdout;
+    if (!out) {
+        fprintf(stderr, "无法创建结果文件: %s\n", sweep_out);
+        free(results);
+        return 1;
+    }
+
+    int jobs = sweep_jobs;
+#ifdef _OPENMP
+    if (jobs <= 0) jobs = omp_get_num_procs();
+#else
+    jobs = 1;
+#endif
+    fprintf(stderr, "参数扫描: %d 组参数 x %d 次重复 = %d 次模拟，%d 个并行任务\n",
+        points, sweep_replicates, runs, jobs);
+    double start = now_seconds();
+    int finished = 0;
+
+#pragma omp parallel for schedule(dynamic) num_threads(jobs)
+    for (int r = 0; r < runs; r++) {
+        ArgList args;
+        args.argc = 0;
+        args.used = 0;
+        args.overflow = 0;
+        arg_add(&args, "%s", program_path);
+        arg_add(&args, "--batch");
+        arg_add(&args, "--csv");
+        arg_add(&args, "--threads"); arg_add(&args, "1");
+        arg_add(&args, "--width"); arg_add(&args, "%d", grid_w);
+        arg_add(&args, "--height"); arg_add(&args, "%d", grid_h);
+        arg_add(&args, "--grass"); arg_add(&args, "%d", init_grass);
+        arg_add(&args, "--season"); arg_add(&args, "%d", start_season);
+        arg_add(&args, "--ticks"); arg_add(&args, "%d", batch_ticks);
+        arg_add(&args, "--seed"); arg_add(&args, "%u", rand_seed + (unsigned int)(r % sweep_replicates));
+        for (int s = 0; s < ANIMAL_SPECIES; s++) {
+            arg_add(&args, "--%s", SPECIES[s].key); arg_add(&args, "%d", species_init[s]);
+            arg_add(&args, "--%s-breed", SPECIES[s].prefix); arg_add(&args, "%.17g", species_breed_prob[s]);
+            arg_add(&args, "--%s-breed-energy", SPECIES[s].prefix); arg_add(&args, "%d", species_breed_energy[s]);
+        }
+        if (grass_skip) arg_add(&args, "--grass-skip");
+        if (density_path) { arg_add(&args, "--density"); arg_add(&args, "%s", density_path); }
+        if (surrogate_path && !validate_surrogate) { arg_add(&args, "--surrogate"); arg_add(&args, "%s", surrogate_path); }
+        // 后出现的参数覆盖前面的默认值；组合编号按维度依次展开
+        int point = r / sweep_replicates;
+        for (int a = sweep_axis_count - 1; a >= 0; a--) {
+            const SweepAxis* axis = &sweep_axes[a];
+            arg_add(&args, "--%s", axis->name);
+            arg_add(&args, "%s", axis->values[point % axis->count]);
+            point /= axis->count;
+        }
+
+        SweepResult* res = &results[r];
+        res->ok = !args.overflow && run_child(&args, res);
+        if (!res->ok) {
+            // 失败时把参数表拼成一行，只用于显示
+            char shown[sizeof(args.text)];
+            int len = 0;
+            for (int i = 0; i < args.argc && len < (int)sizeof(shown) - 1; i++) {
+                len += snprintf(shown + len, sizeof(shown) - len, i ? " %s" : "%s", args.argv[i]);
+            }
+#pragma omp critical
+            fprintf(stderr, "模拟失败: %s\n", shown);
+        }
+
+#pragma omp critical
+        {
+            finished++;
+            fprintf(stderr, "\r已完成 %d/%d", finished, runs);
+        }
+    }
+    fprintf(stderr, "\n用时 %.1f 秒\n", now_seconds() - start);
+
+    // 汇总表：每组参数一行；灭绝回合只在灭绝的重复中取平均，其余列对成功的重复取平均
+    for (int a = 0; a < sweep_axis_count; a++) fprintf(out, "%s,", sweep_axes[a].name);
+    fprintf(out, "runs,failed");
+    for (int s = 0; s < ANIMAL_SPECIES; s++) fprintf(out, ",%s_extinct_runs,%s_extinct_tick", SPECIES[s].prefix, SPECIES[s].prefix);
+    for (int s = 0; s < ANIMAL_SPECIES; s++) fprintf(out, ",max_%s", SPECIES[s].key);
+    for (int s = 0; s < ANIMAL_SPECIES; s++) fprintf(out, ",min_%s", SPECIES[s].key);
+    for (int s = 0; s < ANIMAL_SPECIES; s++) fprintf(out, ",mean_%s", SPECIES[s].key);
+    fprintf(out, ",mean_grass\n");
+    for (int pt = 0; pt < points; pt++) {
+        int idx = pt;
+        const char* labels[MAX_SWEEP_AXES];
+        for (int a = sweep_axis_count - 1; a >= 0; a--) {
+            labels[a] = sweep_axes[a].values[idx % sweep_axes[a].count];
+            idx /= sweep_axes[a].count;
+        }
+        // 各物种的峰值、谷值、平均数量依次排列，最后是青草的平均数量
+        int ok = 0, ext_runs[ANIMAL_SPECIES] = { 0 };
+        double ext_ticks[ANIMAL_SPECIES] = { 0 }, sum[3 * ANIMAL_SPECIES + 1] = { 0 };
+        for (int k = 0; k < sweep_replicates; k++) {
+            const SweepResult* res = &results[pt * sweep_replicates + k];
+            if (!res->ok) continue;
+            const BatchSummary* run = &res->summary;
+            ok++;
+            for (int s = 0; s < ANIMAL_SPECIES; s++) {
+                if (run->extinct_ticks[s] >= 0) { ext_runs[s]++; ext_ticks[s] += run->extinct_ticks[s]; }
+                sum[s] += run->max_counts[s];
+                sum[ANIMAL_SPECIES + s] += run->min_counts[s];
+                sum[2 * ANIMAL_SPECIES + s] += run->means[s];
+            }
+            sum[3 * ANIMAL_SPECIES] += run->mean_grass;
+        }
+        for (int a = 0; a < sweep_axis_count; a++) fprintf(out, "%s,", labels[a]);
+        fprintf(out, "%d,%d", ok, sweep_replicates - ok);
+        for (int s = 0; s < ANIMAL_SPECIES; s++) {
+            fprintf(out, ",%d,", ext_runs[s]);
+            if (ext_runs[s]) fprintf(out, "%.1f", ext_ticks[s] / ext_runs[s]);
+        }
+        for (int c = 0; c < 3 * ANIMAL_SPECIES + 1; c++) fprintf(out, ",%.2f", ok ? sum[c] / ok : 0.0);
+        fprintf(out, "\n");
+    }
+
+    if (out != stdout) fclose(out);
+    free(results);
+    return 0;
 }
 
 void show_welcome() {
@@ -205,7 +1420,8 @@ void show_welcome() {
     printf("  g/G = 青草（嫩/熟） | r = 兔子 |  W = 狼 | . = 空地\n\n");
     printf("  操作说明：\n");
     printf("  [空格] 暂停/继续   [+/–] 调整速度\n");
-    printf("  [R] 重置生态系统   [S] 保存当前状态\n");
+    printf("  [R] 重置生态系统   [S] 保存当前状态   [F] 全速运行\n");
+    printf("  [P] 性能统计面板   [D] 能量与年龄分布\n");
     printf("  [Q] 退出程序\n\n");
     printf(" 特性：\n");
     printf("     草按季节再生（春夏快，秋冬慢）\n");
@@ -219,20 +1435,22 @@ void show_welcome() {
 
 void prompt_initial_counts() {
     clear_screen();
-    printf(" 设置初始数量（总格子: %d）\n", GRID_SIZE * GRID_SIZE);
+    printf(" 设置初始数量（总格子: %d）\n", MAX_ENTITIES);
     printf("（回车使用推荐值）\n\n");
 
     printf("初始青草数量 (为提高模拟的回合，设置了草的自动再生，此初始设置对程序模拟影响很小): ");
     init_grass = get_valid_input(0, MAX_ENTITIES);
     if (init_grass == -1) init_grass = 250;
 
+    int* rabbits = &species_init[SPECIES_OF(RABBIT)];
     printf("兔子数量 [推荐: 40~60]  : ");
-    init_rabbits = get_valid_input(0, MAX_ENTITIES);
-    if (init_rabbits == -1) init_rabbits = 50;
+    *rabbits = get_valid_input(0, MAX_ENTITIES);
+    if (*rabbits == -1) *rabbits = 50;
 
+    int* wolves = &species_init[SPECIES_OF(WOLF)];
     printf("狼的数量 [推荐: 0~8]    : ");
-    init_wolves = get_valid_input(0, MAX_ENTITIES);
-    if (init_wolves == -1) init_wolves = 0;
+    *wolves = get_valid_input(0, MAX_ENTITIES);
+    if (*wolves == -1) *wolves = 0;
 }
 
 // 新增：选择起始季节
@@ -292,342 +1510,14 @@ void clear_screen() {
 #endif
 }
 
-void print_map() {
-    for (int i = 0; i < GRID_SIZE; i++) {
-        for (int j = 0; j < GRID_SIZE; j++) {
-            switch (grid[i][j].type) {
-            case EMPTY:  printf("."); break;
-            case GRASS:
-                if (grid[i][j].grass_regrow_timer < 4)
-                    printf("\033[32mg\033[0m");
-                else
-                    printf("\033[32mG\033[0m");
-                break;
-            case RABBIT: printf("\033[36mr\033[0m"); break;
-            case WOLF:   printf("\033[35mW\033[0m"); break;
-            }
-        }
-        printf("\n");
-    }
-}
-
-void print_status() {
-    printf("\n");
-    printf("【当前状态】 回合: %4d | 季节: %s\n", tick, season_names[season]);
-    printf("青草: %3d | 兔子: %3d | 狼: %3d\n",
-        grass_count, rabbit_count, wolf_count);
-    printf("历史峰值 (兔/狼): %3d/%3d | 谷值: %3d/%3d\n",
-        max_rabbits, max_wolves,
-        (min_rabbits == 9999 ? 0 : min_rabbits),
-        (min_wolves == 9999 ? 0 : min_wolves));
-    printf("模拟速度: %d 毫秒/回合 | 状态: %s\n",
-        delay_ms, paused ? "【已暂停】" : "运行中");
-}
-
-void print_history_chart() {
-    int max_val = 1;
-    for (int i = 0; i < HISTORY_SIZE; i++) {
-        if (history_r[i] > max_val) max_val = history_r[i];
-        if (history_w[i] > max_val) max_val = history_w[i];
-    }
-    if (max_val == 0) max_val = 1;
-
-    int height = 6;
-    printf("\n【种群历史】最近 %d 回合数量变化:\n", HISTORY_SIZE);
-    for (int h = height - 1; h >= 0; h--) {
-        printf("| ");
-        for (int i = 0; i < HISTORY_SIZE; i++) {
-            int idx = (hist_index + i) % HISTORY_SIZE;
-            char c = ' ';
-            if (history_r[idx] * height / max_val > h) c = 'r';
-            if (history_w[idx] * height / max_val > h) c = 'W';
-            printf("%c", c);
-        }
-        printf("\n");
-    }
-    printf("+");
-    for (int i = 0; i < HISTORY_SIZE; i++) printf("-");
-    printf("\n");
-}
-
-void print_legend() {
-    printf("\n【图例】 ");
-    printf("\033[32mg\033[0m=嫩草 ");
-    printf("\033[32mG\033[0m=熟草 ");
-    printf("\033[36mr\033[0m=兔子 ");
-    printf("\033[35mW\033[0m=狼 ");
-    printf(".=空地\n");
-}
-
-void print_controls() {
-    printf("\n【操作】 [空格]=暂停/继续  [+/=]=加速  [-]=减速  [R]=重置  [S]=保存  [Q]=退出\n");
-}
-
-void initialize_grid() {
-    for (int i = 0; i < GRID_SIZE; i++) {
-        for (int j = 0; j < GRID_SIZE; j++) {
-            grid[i][j].type = EMPTY;
-            grid[i][j].x = i;
-            grid[i][j].y = j;
-            grid[i][j].energy = 0;
-            grid[i][j].age = 0;
-            grid[i][j].max_age = 0;
-            grid[i][j].grass_regrow_timer = 0;
-        }
-    }
-    rabbit_count = wolf_count = grass_count = 0;
-    max_rabbits = max_wolves = 0;
-    min_rabbits = min_wolves = 9999;
-    hist_index = 0;
-    memset(history_r, 0, sizeof(history_r));
-    memset(history_w, 0, sizeof(history_w));
-
-    spawn_random(GRASS, init_grass);
-    spawn_random(RABBIT, init_rabbits);
-    spawn_random(WOLF, init_wolves);
-
-    // 设置初始季节
-    season = start_season;
-    tick = 0;
-}
-
-void spawn_random(EntityType type, int count) {
-    int placed = 0;
-    int attempts = 0;
-    while (placed < count && attempts < MAX_ENTITIES * 2) {
-        int x = rand() % GRID_SIZE;
-        int y = rand() % GRID_SIZE;
-        if (grid[x][y].type == EMPTY) {
-            grid[x][y].type = type;
-            grid[x][y].age = 0;
-            switch (type) {
-            case RABBIT:
-                grid[x][y].energy = 12;
-                grid[x][y].max_age = 30 + rand() % 20;
-                rabbit_count++;
-                break;
-            case WOLF:
-                grid[x][y].energy = 25;
-                grid[x][y].max_age = 50 + rand() % 20;
-                wolf_count++;
-                break;
-            case GRASS:
-                grid[x][y].grass_regrow_timer = 0;
-                grass_count++;
-                break;
-            }
-            placed++;
-        }
-        attempts++;
-    }
-}
-
-void update_season() {
-    // 从 start_season 开始，每100回合换季
-    season = (start_season + tick / 100) % 4;
-}
-
-void update_grass() {
-    double spawn_prob = 0.0;
-    switch (season) {
-    case 0: spawn_prob = 0.12; break; // 春
-    case 1: spawn_prob = 0.10; break; // 夏
-    case 2: spawn_prob = 0.03; break; // 秋
-    case 3: spawn_prob = 0.005; break; // 冬
-    }
-
-    for (int i = 0; i < GRID_SIZE; i++) {
-        for (int j = 0; j < GRID_SIZE; j++) {
-            if (grid[i][j].type == EMPTY) {
-                if (rand() / (double)RAND_MAX < spawn_prob) {
-                    grid[i][j].type = GRASS;
-                    grid[i][j].grass_regrow_timer = 0;
-                    grass_count++;
-                }
-            }
-            else if (grid[i][j].type == GRASS) {
-                grid[i][j].grass_regrow_timer++;
-            }
-        }
-    }
-}
-
-int find_nearest_in_original_grid(EntityType me, EntityType target, int x, int y, int* out_x, int* out_y) {
-    int min_dist = GRID_SIZE * 2;
-    int found = 0;
-    int best_x = -1, best_y = -1;
-    int radius = (me == RABBIT) ? 4 : 6;
-
-    for (int dx = -radius; dx <= radius; dx++) {
-        for (int dy = -radius; dy <= radius; dy++) {
-            int nx = x + dx, ny = y + dy;
-            if (!is_valid(nx, ny)) continue;
-            if (grid[nx][ny].type == target) {
-                int dist = abs(dx) + abs(dy);
-                if (dist < min_dist) {
-                    min_dist = dist;
-                    best_x = nx;
-                    best_y = ny;
-                    found = 1;
-                }
-            }
-        }
-    }
-    if (found) {
-        *out_x = best_x;
-        *out_y = best_y;
-        return 1;
-    }
-    return 0;
-}
-
-void update_entities() {
-    Entity new_grid[GRID_SIZE][GRID_SIZE];
-    for (int i = 0; i < GRID_SIZE; i++) {
-        for (int j = 0; j < GRID_SIZE; j++) {
-            new_grid[i][j].type = EMPTY;
-            new_grid[i][j].grass_regrow_timer = 0;
-        }
-    }
-
-    rabbit_count = wolf_count = grass_count = 0;
-
-    for (int i = 0; i < GRID_SIZE; i++) {
-        for (int j = 0; j < GRID_SIZE; j++) {
-            if (grid[i][j].type == GRASS) {
-                new_grid[i][j] = grid[i][j];
-                grass_count++;
-            }
-        }
-    }
-
-    for (int i = 0; i < GRID_SIZE; i++) {
-        for (int j = 0; j < GRID_SIZE; j++) {
-            if (grid[i][j].type == RABBIT || grid[i][j].type == WOLF) {
-                Entity* e = &grid[i][j];
-                int new_x = i, new_y = j;
-                int energy_gain = 0;
-
-                int move_cost = (e->type == WOLF) ? 2 : 1;
-                if (season == 3) move_cost *= 2;
-
-                int dx = 0, dy = 0;
-                if (e->type == RABBIT) {
-                    int tx, ty;
-                    if (find_nearest_in_original_grid(RABBIT, GRASS, i, j, &tx, &ty)) {
-                        dx = (tx - i > 0) ? 1 : (tx - i < 0) ? -1 : 0;
-                        dy = (ty - j > 0) ? 1 : (ty - j < 0) ? -1 : 0;
-                    }
-                    else {
-                        int dirs[8][2] = { {-1,-1},{-1,0},{-1,1},{0,-1},{0,1},{1,-1},{1,0},{1,1} };
-                        int idx = rand() % 8;
-                        dx = dirs[idx][0];
-                        dy = dirs[idx][1];
-                    }
-                }
-                else if (e->type == WOLF) {
-                    int tx, ty;
-                    if (find_nearest_in_original_grid(WOLF, RABBIT, i, j, &tx, &ty)) {
-                        dx = (tx - i > 0) ? 1 : (tx - i < 0) ? -1 : 0;
-                        dy = (ty - j > 0) ? 1 : (ty - j < 0) ? -1 : 0;
-                    }
-                    else {
-                        int dirs[8][2] = { {-1,-1},{-1,0},{-1,1},{0,-1},{0,1},{1,-1},{1,0},{1,1} };
-                        int idx = rand() % 8;
-                        dx = dirs[idx][0];
-                        dy = dirs[idx][1];
-                    }
-                }
-
-                int nx = i + dx;
-                int ny = j + dy;
-                if (is_valid(nx, ny) && (new_grid[nx][ny].type == EMPTY || new_grid[nx][ny].type == GRASS)) {
-                    new_x = nx;
-                    new_y = ny;
-                }
-
-                if (e->type == RABBIT && grid[new_x][new_y].type == GRASS) {
-                    energy_gain = 10;
-                }
-                else if (e->type == WOLF && grid[new_x][new_y].type == RABBIT) {
-                    energy_gain = 25;
-                }
-
-                new_grid[new_x][new_y].type = e->type;
-                new_grid[new_x][new_y].x = new_x;
-                new_grid[new_x][new_y].y = new_y;
-                new_grid[new_x][new_y].age = e->age + 1;
-                new_grid[new_x][new_y].max_age = e->max_age;
-                new_grid[new_x][new_y].energy = e->energy - move_cost + energy_gain;
-                new_grid[new_x][new_y].grass_regrow_timer = 0;
-            }
-        }
-    }
-
-    for (int i = 0; i < GRID_SIZE; i++) {
-        for (int j = 0; j < GRID_SIZE; j++) {
-            Entity* e = &new_grid[i][j];
-            if (e->type == GRASS) {
-                grass_count++;
-            }
-            else if (e->type == RABBIT || e->type == WOLF) {
-                if (e->energy <= 0 || e->age > e->max_age) {
-                    e->type = EMPTY;
-                    continue;
-                }
-
-                if (e->type == RABBIT) rabbit_count++;
-                else if (e->type == WOLF) wolf_count++;
-
-                double breed_prob = 0.0;
-                int min_energy = 0;
-                if (e->type == RABBIT) {
-                    breed_prob = 0.35;
-                    min_energy = 22;
-                }
-                else if (e->type == WOLF) {
-                    breed_prob = 0.20;
-                    min_energy = 35;
-                }
-
-                if (e->energy >= min_energy && rand() / (double)RAND_MAX < breed_prob) {
-                    handle_reproduction_in_new_grid(e, new_grid);
-                }
-            }
-        }
-    }
-
-    memcpy(grid, new_grid, sizeof(grid));
-}
-
-void handle_reproduction_in_new_grid(Entity* parent, Entity new_grid[GRID_SIZE][GRID_SIZE]) {
-    for (int attempt = 0; attempt < 12; attempt++) {
-        int dx = (rand() % 3) - 1;
-        int dy = (rand() % 3) - 1;
-        if (dx == 0 && dy == 0) continue;
-        int nx = parent->x + dx;
-        int ny = parent->y + dy;
-        if (is_valid(nx, ny) && new_grid[nx][ny].type == EMPTY) {
-            new_grid[nx][ny].type = parent->type;
-            new_grid[nx][ny].x = nx;
-            new_grid[nx][ny].y = ny;
-            new_grid[nx][ny].age = 0;
-            new_grid[nx][ny].max_age = parent->max_age;
-            new_grid[nx][ny].energy = (parent->type == RABBIT) ? 10 : 15;
-            new_grid[nx][ny].grass_regrow_timer = 0;
-            parent->energy -= (parent->type == RABBIT) ? 10 : 15;
-            if (parent->energy < 5) parent->energy = 5;
-            break;
-        }
-    }
-}
-
-int is_valid(int x, int y) {
-    return x >= 0 && x < GRID_SIZE && y >= 0 && y < GRID_SIZE;
-}
-
+// S 键：写入二进制存档（可用 --resume 恢复）和一份可读的字符地图，不打断模拟
 void save_snapshot() {
     char filename[128];
+    sprintf(filename, "生态系统_回合_%d.eco", tick);
+    if (!save_checkpoint(filename)) {
+        set_message("保存失败！无法创建存档文件");
+        return;
+    }
     sprintf(filename, "生态系统_回合_%d.txt", tick);
     FILE* f = fopen(filename, "w");
     if (!f) {
@@ -635,29 +1525,33 @@ void save_snapshot() {
         return;
     }
     fprintf(f, "生态系统快照 - 回合 %d（季节：%s）\n", tick, season_names[season]);
-    fprintf(f, "青草: %d, 兔子: %d, 狼: %d\n\n",
-        grass_count, rabbit_count, wolf_count);
-    for (int i = 0; i < GRID_SIZE; i++) {
-        for (int j = 0; j < GRID_SIZE; j++) {
-            switch (grid[i][j].type) {
-            case EMPTY: fputc('.', f); break;
-            case GRASS: fputc('G', f); break;
-            case RABBIT: fputc('r', f); break;
-            case WOLF: fputc('W', f); break;
+    fprintf(f, "青草: %d", grass_count);
+    for (int s = 0; s < ANIMAL_SPECIES; s++) fprintf(f, ", %s: %d", SPECIES[s].name, species_count[s]);
+    fprintf(f, "\n\n");
+    for (int i = 0; i < grid_h; i++) {
+        for (int j = 0; j < grid_w; j++) {
+            if (PLANE_TEST(grass_bits, i, j)) {
+                fputc('G', f);
+                continue;
             }
+            EntityType type = animal_at(i, j);
+            fputc(type == EMPTY ? '.' : SPECIES[SPECIES_OF(type)].glyph, f);
         }
         fputc('\n', f);
     }
     fclose(f);
 
-    clear_screen();
-    print_map();
-    print_status();
-    print_history_chart();
-    print_legend();
-    print_controls();
-    printf("\n 快照已保存至: %s\n", filename);
-    printf("按任意键继续...\n");
-    _getch();
-    set_message("快照已保存");
-}
\ No newline at end of file
+    char msg[128];
+    snprintf(msg, sizeof(msg), "快照已保存: 生态系统_回合_%d.eco / .txt", tick);
+    set_message(msg);
+}
+
+// 退出时写出性能统计；未编译进性能统计时只给出提示
+void write_profile() {
+    if (!profile_path) return;
+#ifdef ECO_PROFILE
+    if (!prof_write_json(profile_path)) fprintf(stderr, "无法写入性能统计: %s\n", profile_path);
+#else
+    fprintf(stderr, "--profile 无效：本程序编译时未定义 ECO_PROFILE\n");
+#endif
+}
@@ -0,0 +1,393 @@
+﻿#define _CRT_SECURE_NO_WARNINGS
+#include "ecosystem.h"
+#include "render.h"
+#include "species.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// 基准测试：对每种 (地图尺寸, 初始密度, 季节) 生成世界，分别测量各阶段的吞吐量。
+// 结果每个测量一行，写成 CSV（--out 以 .json 结尾时为 JSON），便于在不同提交之间比较
+#define MAX_BENCH_VALUES 32
+
+int bench_sizes[MAX_BENCH_VALUES] = { 28, 64, 256, 1024, 4096 };
+int bench_size_count = 5;
+double bench_densities[MAX_BENCH_VALUES] = { 0.02, 0.1, 0.3 };
+int bench_density_count = 3;
+int bench_seasons[MAX_BENCH_VALUES] = { 0, 1, 2, 3 };
+int bench_season_count = 4;
+double bench_seconds = 0.2; // 每项测量的最短计时
+int bench_warmup = 3;       // 开始计时前先推进的回合数，让世界离开初始的均匀分布
+int bench_tick_count = 10;  // 回合类测量每轮推进的回合数
+int bench_threads = 0;
+unsigned int bench_seed = 1;
+const char* bench_out = NULL;
+
+FILE* out = NULL;
+int json_output = 0;
+int result_count = 0;
+volatile int bench_sink = 0; // 保存搜索结果，避免被编译器当作无用代码删掉
+
+// 一项测量的结果；rate 的单位随测量而不同，ns_per_cell 按本次测量实际处理的格子数折算
+typedef struct {
+    const char* name;
+    int size;
+    double density;
+    int season;
+    int grass, counts[ANIMAL_SPECIES]; // 开始测量时的数量
+    long long iterations;
+    double seconds;
+    double rate;
+    const char* unit;
+    double ns_per_cell;
+} BenchResult;
+
+int parse_bench_args(int argc, char** argv);
+int parse_list(const char* arg, double* values, int max_count);
+void reset_world();
+void bench_world(int size, double density, int season);
+void bench_init(BenchResult* res);
+void bench_ticks(BenchResult* grass, BenchResult* entities);
+void bench_find_nearest(BenchResult* res);
+void bench_render(BenchResult* res, int full);
+void write_result(const BenchResult* res);
+
+int main(int argc, char** argv) {
+    if (!parse_bench_args(argc, argv)) return 1;
+#ifdef _OPENMP
+    if (bench_threads > 0) omp_set_num_threads(bench_threads);
+    int threads = omp_get_max_threads();
+#else
+    int threads = 1;
+#endif
+
+    out = bench_out ? fopen(bench_out, "w") : stdout;
+    if (!out) {
+        fprintf(stderr, "无法创建结果文件: %s\n", bench_out);
+        return 1;
+    }
+    size_t n = bench_out ? strlen(bench_out) : 0;
+    json_output = n >= 5 && strcmp(bench_out + n - 5, ".json") == 0;
+    if (json_output) fprintf(out, "{\"threads\":%d,\"seed\":%u,\"results\":[\n", threads, bench_seed);
+    else {
+        fprintf(out, "benchmark,width,height,density,season,threads,grass");
+        for (int s = 0; s < ANIMAL_SPECIES; s++) fprintf(out, ",%s", SPECIES[s].key);
+        fprintf(out, ",iterations,seconds,rate,unit,ns_per_cell\n");
+    }
+
+    for (int s = 0; s < bench_size_count; s++) {
+        grid_w = grid_h = bench_sizes[s];
+        if (!alloc_world()) {
+            fprintf(stderr, "内存不足：跳过 %d x %d 的地图\n", grid_w, grid_h);
+            continue;
+        }
+        for (int d = 0; d < bench_density_count; d++) {
+            for (int k = 0; k < bench_season_count; k++) {
+                fprintf(stderr, "%d x %d | 密度 %.3f | %s\n",
+                    grid_w, grid_h, bench_densities[d], season_names[bench_seasons[k]]);
+                bench_world(bench_sizes[s], bench_densities[d], bench_seasons[k]);
+            }
+        }
+        free_world();
+    }
+    render_release();
+    free(view.glyphs);
+
+    if (json_output) fprintf(out, "\n]}\n");
+    if (out != stdout) fclose(out);
+    return 0;
+}
+
+// --sizes/--densities/--seasons 取逗号分隔的列表，其余选项取单个值
+int parse_bench_args(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        const char* opt = argv[i];
+        if (strcmp(opt, "--help") == 0 || strcmp(opt, "-h") == 0) {
+            printf("用法: %s [选项]\n", argv[0]);
+            printf("  --sizes N,N,...      地图边长（默认 28,64,256,1024,4096）\n");
+            printf("  --densities P,P,...  初始密度：青草和兔子各占格子数的比例，狼为兔子的 1/10（默认 0.02,0.1,0.3）\n");
+            printf("  --seasons S,S,...    测量时固定的季节 0-3（默认 0,1,2,3）\n");
+            printf("  --seconds T          每项测量的最短时间（默认 %.1f 秒）\n", bench_seconds);
+            printf("  --warmup N           计时前先推进的回合数（默认 %d）\n", bench_warmup);
+            printf("  --ticks N            回合类测量每轮推进的回合数（默认 %d）\n", bench_tick_count);
+            printf("  --threads N          模拟使用的线程数（默认 0=全部核心）\n");
+            printf("  --seed N             随机种子（默认 %u）\n", bench_seed);
+            printf("  --grass-skip 0|1     青草是否按几何跳跃抽样（默认 0）\n");
+            printf("  --out 文件           结果文件，.json 结尾为 JSON，否则为 CSV（默认输出到屏幕）\n");
+            exit(0);
+        }
+        if (i + 1 >= argc) {
+            fprintf(stderr, "未知参数或缺少取值: %s\n", opt);
+            return 0;
+        }
+        const char* arg = argv[++i];
+        double values[MAX_BENCH_VALUES];
+        int count = 0;
+        if (strcmp(opt, "--sizes") == 0 || strcmp(opt, "--seasons") == 0) {
+            int is_size = strcmp(opt, "--sizes") == 0;
+            count = parse_list(arg, values, MAX_BENCH_VALUES);
+            for (int k = 0; k < count; k++) {
+                int v = (int)values[k];
+                if (v != values[k] || (is_size ? v < 1 || v > 46340 : v < 0 || v > 3)) count = 0; // 格子总数不超过 INT_MAX
+                (is_size ? bench_sizes : bench_seasons)[k] = v;
+            }
+            if (is_size) bench_size_count = count;
+            else bench_season_count = count;
+        }
+        else if (strcmp(opt, "--densities") == 0) {
+            count = parse_list(arg, values, MAX_BENCH_VALUES);
+            for (int k = 0; k < count; k++) {
+                if (values[k] < 0.0 || values[k] > 1.0) count = 0;
+                bench_densities[k] = values[k];
+            }
+            bench_density_count = count;
+        }
+        else if (strcmp(opt, "--seconds") == 0) {
+            count = parse_list(arg, values, 1);
+            if (count == 1 && values[0] >= 0) bench_seconds = values[0];
+            else count = 0;
+        }
+        else if (strcmp(opt, "--warmup") == 0 || strcmp(opt, "--ticks") == 0
+            || strcmp(opt, "--threads") == 0 || strcmp(opt, "--seed") == 0 || strcmp(opt, "--grass-skip") == 0) {
+            char* end;
+            unsigned long v = strtoul(arg, &end, 10);
+            count = end != arg && *end == '\0' && v <= INT_MAX;
+            if (strcmp(opt, "--ticks") == 0) {
+                if (v == 0) count = 0;
+                bench_tick_count = (int)v;
+            }
+            else if (strcmp(opt, "--warmup") == 0) bench_warmup = (int)v;
+            else if (strcmp(opt, "--threads") == 0) bench_threads = (int)v;
+            else if (strcmp(opt, "--grass-skip") == 0) {
+                if (v > 1) count = 0;
+                grass_skip = (int)v;
+            }
+            else bench_seed = (unsigned int)v;
+        }
+        else if (strcmp(opt, "--out") == 0) {
+            bench_out = arg;
+            count = 1;
+        }
+        else {
+            fprintf(stderr, "未知参数: %s\n", opt);
+            return 0;
+        }
+        if (count == 0) {
+            fprintf(stderr, "参数 %s 的取值无效: %s\n", opt, arg);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// 解析逗号分隔的数值列表；格式错误或超过 max_count 个时返回 0
+int parse_list(const char* arg, double* values, int max_count) {
+    int count = 0;
+    const char* p = arg;
+    for (;;) {
+        char* end;
+        double v = strtod(p, &end);
+        if (end == p || count == max_count) return 0;
+        values[count++] = v;
+        if (*end == '\0') return count;
+        if (*end != ',') return 0;
+        p = end + 1;
+    }
+}
+
+// 重新生成世界并推进 bench_warmup 回合。每项测量都从这一状态开始，
+// 因此同一组参数在不同提交之间测量的是相同的工作量
+void reset_world() {
+    rng_init(bench_seed);
+    initialize_grid();
+    // 测量期间不调用 update_season，季节保持不变
+    for (int t = 0; t < bench_warmup; t++) {
+        update_grass();
+        update_entities();
+        record_tick_stats();
+        tick++;
+    }
+}
+
+// 按给定参数生成世界，依次执行各项测量
+void bench_world(int size, double density, int season) {
+    long long cells = (long long)size * size;
+    init_grass = (int)(cells * density);
+    species_init[SPECIES_OF(RABBIT)] = (int)(cells * density);
+    species_init[SPECIES_OF(WOLF)] = species_init[SPECIES_OF(RABBIT)] / 10;
+    start_season = season;
+
+    BenchResult results[6];
+    for (int k = 0; k < 6; k++) {
+        BenchResult* res = &results[k];
+        memset(res, 0, sizeof(*res));
+        res->size = size;
+        res->density = density;
+        res->season = season;
+    }
+    bench_ticks(&results[0], &results[1]);
+    bench_find_nearest(&results[2]);
+    bench_render(&results[3], 1);
+    bench_render(&results[4], 0);
+    bench_init(&results[5]);
+    for (int k = 0; k < 6; k++) {
+        if (results[k].iterations > 0) write_result(&results[k]);
+    }
+}
+
+static void snapshot_counts(BenchResult* res) {
+    res->grass = grass_count;
+    memcpy(res->counts, species_count, sizeof(res->counts));
+}
+
+// 完整回合：每轮从初始状态推进 bench_tick_count 回合，分别累计 update_grass 和
+// update_entities 的用时，单位为回合/秒
+void bench_ticks(BenchResult* grass, BenchResult* entities) {
+    long long cells = (long long)grid_w * grid_h;
+    grass->name = "update_grass";
+    entities->name = "update_entities";
+    grass->unit = entities->unit = "ticks/s";
+    double start = now_seconds();
+    do {
+        reset_world();
+        snapshot_counts(grass);
+        snapshot_counts(entities);
+        for (int t = 0; t < bench_tick_count; t++) {
+            double t0 = now_seconds();
+            update_grass();
+            double t1 = now_seconds();
+            update_entities();
+            double t2 = now_seconds();
+            record_tick_stats();
+            tick++;
+            grass->seconds += t1 - t0;
+            entities->seconds += t2 - t1;
+        }
+        grass->iterations += bench_tick_count;
+        entities->iterations += bench_tick_count;
+    } while (now_seconds() - start < bench_seconds);
+    grass->rate = grass->iterations / grass->seconds;
+    entities->rate = entities->iterations / entities->seconds;
+    grass->ns_per_cell = grass->seconds * 1e9 / (grass->iterations * cells);
+    entities->ns_per_cell = entities->seconds * 1e9 / (entities->iterations * cells);
+}
+
+// 对初始状态中的每只动物做一次方框搜索（各自找自己的食物），单位为次/秒；
+// ns_per_cell 按搜索方框的格数折算。没有动物时不输出
+void bench_find_nearest(BenchResult* res) {
+    res->name = "find_nearest_in_original_grid";
+    res->unit = "queries/s";
+    reset_world();
+    snapshot_counts(res);
+    int animals = 0;
+    long long boxes = 0; // 一轮搜索覆盖的方框格数
+    for (int s = 0; s < ANIMAL_SPECIES; s++) {
+        int box = 2 * SPECIES[s].search_radius + 1;
+        animals += species_count[s];
+        boxes += (long long)species_count[s] * box * box;
+    }
+    if (animals == 0) return;
+    long long box_cells = 0;
+    int found = 0;
+    double start = now_seconds();
+    do {
+        for (int b = 0; b < band_count; b++) {
+            for (int s = 0; s < ANIMAL_SPECIES; s++) {
+                for (int k = 0; k < bands[b].animals[s].count; k++) {
+                    int cell = bands[b].animals[s].cells[k], tx, ty;
+                    found += find_nearest_in_original_grid(SPECIES[s].type, SPECIES[s].food, cell / grid_w, cell % grid_w, &tx, &ty);
+                }
+            }
+        }
+        res->iterations += animals;
+        box_cells += boxes;
+    } while (now_seconds() - start < bench_seconds);
+    res->seconds = now_seconds() - start;
+    res->rate = res->iterations / res->seconds;
+    res->ns_per_cell = res->seconds * 1e9 / box_cells;
+    bench_sink = found;
+}
+
+// 生成世界（放置青草与动物），单位为次/秒
+void bench_init(BenchResult* res) {
+    long long cells = (long long)grid_w * grid_h;
+    res->name = "initialize_grid";
+    res->unit = "worlds/s";
+    double start = now_seconds();
+    do {
+        rng_init(bench_seed);
+        double t0 = now_seconds();
+        initialize_grid();
+        res->seconds += now_seconds() - t0;
+        res->iterations++;
+    } while (now_seconds() - start < bench_seconds);
+    snapshot_counts(res);
+    res->rate = res->iterations / res->seconds;
+    res->ns_per_cell = res->seconds * 1e9 / (res->iterations * cells);
+}
+
+// 组装一帧：把世界复制为画面 (publish_view) 并生成终端输出，但不写给终端
+static double time_frame() {
+    double t0 = now_seconds();
+    publish_view();
+    {
+        std::lock_guard<std::mutex> lock(view_mutex);
+        render_compose();
+    }
+    return now_seconds() - t0;
+}
+
+// 交互模式每帧的工作，单位为帧/秒。full 为 1 时对初始状态反复整屏重绘；
+// 为 0 时每轮从初始状态推进 bench_tick_count 回合（不计时），每回合一帧，只重绘变化的格子
+void bench_render(BenchResult* res, int full) {
+    long long cells = (long long)grid_w * grid_h;
+    res->name = full ? "render_full" : "render_diff";
+    res->unit = "frames/s";
+    double start = now_seconds();
+    do {
+        reset_world();
+        snapshot_counts(res);
+        render_invalidate();
+        if (full) {
+            res->seconds += time_frame();
+            res->iterations++;
+            continue;
+        }
+        time_frame();
+        for (int t = 0; t < bench_tick_count; t++) {
+            update_grass();
+            update_entities();
+            record_tick_stats();
+            tick++;
+            res->seconds += time_frame();
+            res->iterations++;
+        }
+    } while (now_seconds() - start < bench_seconds);
+    res->rate = res->iterations / res->seconds;
+    res->ns_per_cell = res->seconds * 1e9 / (res->iterations * cells);
+}
+
+void write_result(const BenchResult* res) {
+#ifdef _OPENMP
+    int threads = omp_get_max_threads();
+#else
+    int threads = 1;
+#endif
+    if (json_output) {
+        fprintf(out, "%s{\"benchmark\":\"%s\",\"width\":%d,\"height\":%d,\"density\":%g,\"season\":%d,"
+            "\"threads\":%d,\"grass\":%d", result_count ? ",\n" : "", res->name, res->size, res->size,
+            res->density, res->season, threads, res->grass);
+        for (int s = 0; s < ANIMAL_SPECIES; s++) fprintf(out, ",\"%s\":%d", SPECIES[s].key, res->counts[s]);
+        fprintf(out, ",\"iterations\":%lld,\"seconds\":%.6f,\"rate\":%.3f,\"unit\":\"%s\",\"ns_per_cell\":%.4f}",
+            res->iterations, res->seconds, res->rate, res->unit, res->ns_per_cell);
+    }
+    else {
+        fprintf(out, "%s,%d,%d,%g,%d,%d,%d", res->name, res->size, res->size, res->density, res->season,
+            threads, res->grass);
+        for (int s = 0; s < ANIMAL_SPECIES; s++) fprintf(out, ",%d", res->counts[s]);
+        fprintf(out, ",%lld,%.6f,%.3f,%s,%.4f\n", res->iterations, res->seconds, res->rate, res->unit, res->ns_per_cell);
+    }
+    fflush(out);
+    result_count++;
+}
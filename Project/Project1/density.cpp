@@ -0,0 +1,105 @@
+﻿#define _CRT_SECURE_NO_WARNINGS
+#include "density.h"
+#include "species.h"
+
+DensityMap density_maps[ENTITY_TYPES];
+
+// 读一个以空白分隔的词，跳过 # 开始的注释；读到文件末尾返回 0
+static int read_token(FILE* f, char* buf, int size) {
+    int c, len = 0;
+    for (;;) {
+        c = fgetc(f);
+        if (c == '#') {
+            while (c != EOF && c != '\n') c = fgetc(f);
+        }
+        if (c == EOF) return 0;
+        if (c != ' ' && c != '\t' && c != '\r' && c != '\n') break;
+    }
+    while (c != EOF && c != ' ' && c != '\t' && c != '\r' && c != '\n' && c != '#') {
+        if (len < size - 1) buf[len++] = (char)c;
+        c = fgetc(f);
+    }
+    if (c == '#') ungetc(c, f);
+    buf[len] = '\0';
+    return 1;
+}
+
+void density_free() {
+    for (int t = 0; t < ENTITY_TYPES; t++) {
+        free(density_maps[t].weights);
+        density_maps[t].weights = NULL;
+        density_maps[t].rows = density_maps[t].cols = 0;
+    }
+}
+
+// 读入密度图，出错时说明原因并返回 0（此时不保留任何一张图）
+int density_load(const char* path) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "无法打开密度图: %s\n", path);
+        return 0;
+    }
+    density_free();
+    char tok[64];
+    int ok = 1;
+    while (ok && read_token(f, tok, sizeof(tok))) {
+        // 类型名与设置初始数量的命令行参数同名：grass 或特性表中的 key
+        int type = strcmp(tok, "grass") == 0 ? GRASS : -1;
+        for (int s = 0; s < ANIMAL_SPECIES; s++) {
+            if (strcmp(tok, SPECIES[s].key) == 0) type = SPECIES[s].type;
+        }
+        char rows_tok[64], cols_tok[64];
+        int rows = 0, cols = 0;
+        if (type < 0) {
+            fprintf(stderr, "密度图 %s: 未知的类型 \"%s\"（应为 grass", path, tok);
+            for (int s = 0; s < ANIMAL_SPECIES; s++) fprintf(stderr, "、%s", SPECIES[s].key);
+            fprintf(stderr, " 之一）\n");
+            ok = 0;
+        }
+        else if (density_maps[type].rows) {
+            fprintf(stderr, "密度图 %s: %s 出现了两次\n", path, tok);
+            ok = 0;
+        }
+        else if (!read_token(f, rows_tok, sizeof(rows_tok)) || !read_token(f, cols_tok, sizeof(cols_tok))
+            || (rows = atoi(rows_tok)) < 1 || rows > DENSITY_MAX_SIZE || (cols = atoi(cols_tok)) < 1 || cols > DENSITY_MAX_SIZE) {
+            fprintf(stderr, "密度图 %s: %s 之后应为行数和列数（1~%d）\n", path, tok, DENSITY_MAX_SIZE);
+            ok = 0;
+        }
+        if (!ok) break;
+
+        DensityMap* map = &density_maps[type];
+        const char* name = type == GRASS ? "grass" : SPECIES[SPECIES_OF(type)].key;
+        map->weights = (double*)malloc((size_t)rows * cols * sizeof(double));
+        if (!map->weights) {
+            fprintf(stderr, "内存不足，无法读入密度图\n");
+            ok = 0;
+            break;
+        }
+        double total = 0;
+        for (int k = 0; k < rows * cols && ok; k++) {
+            char* end;
+            if (!read_token(f, tok, sizeof(tok))) {
+                fprintf(stderr, "密度图 %s: %s 只有 %d 个权重，应为 %d x %d 个\n", path, name, k, rows, cols);
+                ok = 0;
+                break;
+            }
+            double w = strtod(tok, &end);
+            if (*end != '\0' || !(w >= 0) || w > 1e12) {
+                fprintf(stderr, "密度图 %s: 权重 \"%s\" 不是非负数\n", path, tok);
+                ok = 0;
+                break;
+            }
+            map->weights[k] = w;
+            total += w;
+        }
+        if (ok && total <= 0) {
+            fprintf(stderr, "密度图 %s: %s 的权重全为 0\n", path, name);
+            ok = 0;
+        }
+        map->rows = rows;
+        map->cols = cols;
+    }
+    fclose(f);
+    if (!ok) density_free();
+    return ok;
+}
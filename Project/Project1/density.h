@@ -0,0 +1,19 @@
+﻿// 密度图：--density 文件为青草和各物种指定初始放置的相对密度，例如草多的草甸、狼的巢穴。
+// 每种类型一张粗网格，拉伸覆盖整张地图：第 i 行第 j 列的格子取第 i*rows/grid_h 行、第 j*cols/grid_w 列的权重。
+// 文件由若干段组成，每段为类型名 (grass/rabbits/wolves/foxes)、行数、列数，再是行优先的非负权重；
+// # 之后到行尾为注释。未出现的类型在整张地图上均匀放置
+#pragma once
+
+#include "ecosystem.h"
+
+#define DENSITY_MAX_SIZE 4096 // 密度图每边的最大格数
+
+typedef struct {
+    int rows, cols;  // 0 表示未指定，均匀放置
+    double* weights; // rows x cols
+} DensityMap;
+
+extern DensityMap density_maps[ENTITY_TYPES]; // 以 EntityType 为下标，EMPTY 不用
+
+int density_load(const char* path);
+void density_free();
@@ -0,0 +1,254 @@
+﻿#define _CRT_SECURE_NO_WARNINGS
+#include "domain.h"
+#include "ecosystem.h"
+#include "species.h"
+#include <atomic>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <signal.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#endif
+
+int process_count = 1;
+int process_rank = 0;
+
+// 一个进程本回合负责的条带的合计，汇总后就是全局的数量与事件
+typedef struct {
+    int grass;
+    int counts[ANIMAL_SPECIES], births[ANIMAL_SPECIES], deaths[ANIMAL_SPECIES], predations[ANIMAL_SPECIES];
+    int chunks; // 已分配的区块（含边界带）
+    SpeciesCensus census[ANIMAL_SPECIES];
+    int densest_tile, densest_animals;
+} DomainTotals;
+
+// 共享内存的开头：栅栏与各进程的合计；之后是各进程首尾两条带的状态 (save_band_state)。
+// 合计与条带状态都按回合的奇偶双缓冲，每回合只需一次栅栏：相邻进程读完第 t 回合的数据之前，
+// 不会有人写到同一块缓冲（那要等到第 t + 2 回合）
+typedef struct {
+    std::atomic<int> arrived; // 已到达栅栏的进程数
+    std::atomic<int> phase;   // 每通过一次栅栏加一
+    std::atomic<int> failed;  // 有进程异常退出时置 1，其余进程随之退出
+    DomainTotals totals[2][DOMAIN_MAX_PROCS];
+} DomainControl;
+
+static DomainControl* control = NULL;
+static unsigned char* slots = NULL;
+static size_t shared_size = 0, slot_size = 0;
+static int own_lo = 0, own_hi = 0; // 本进程负责的条带 [own_lo, own_hi)
+static int last_parity = -1;       // 最近一次交换所用的缓冲，-1 表示还没有交换过
+static double last_pass = 0;       // 上一次通过栅栏的时刻
+static double longest_tick = 0;    // 两次通过栅栏之间最长的间隔
+#ifndef _WIN32
+static pid_t children[DOMAIN_MAX_PROCS];
+static int reaped[DOMAIN_MAX_PROCS];
+static int child_status[DOMAIN_MAX_PROCS];
+static pid_t parent_pid = 0;
+#endif
+
+// 第 rank 个进程的首 (edge = 0) 或尾 (edge = 1) 条带在 parity 缓冲中的位置
+static unsigned char* slot(int rank, int edge, int parity) {
+    return slots + ((size_t)(rank * 2 + edge) * 2 + parity) * slot_size;
+}
+
+// 按进程数分出本进程的条带，分出子进程后每个进程只保留自己的一段和两侧的边界带。
+// 必须在进入任何 OpenMP 并行区之前调用：分叉只复制调用线程，之前建好的线程池在子进程里已经失效，
+// 子进程再进入多线程的并行区会永远卡住。读档（串行）可以在此之前，新世界在此之后由各进程各自生成
+// （initialize_grid 只放置本进程的条带）；procs 不超过条带数
+int domain_start(int procs) {
+    if (procs > band_count) procs = band_count;
+    process_count = procs > 1 ? procs : 1;
+    process_rank = 0;
+    if (process_count == 1) return 1;
+#ifdef _WIN32
+    fprintf(stderr, "多进程模式 (--procs) 目前只支持 Linux/macOS\n");
+    return 0;
+#else
+    slot_size = (band_state_size() + 63) / 64 * 64;
+    size_t header = (sizeof(DomainControl) + 4095) / 4096 * 4096;
+    shared_size = header + (size_t)process_count * 4 * slot_size;
+    void* mem = mmap(NULL, shared_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+        fprintf(stderr, "无法分配 %.1f MB 共享内存\n", shared_size / 1048576.0);
+        return 0;
+    }
+    control = (DomainControl*)mem; // 匿名映射已清零，原子量的初值即为 0
+    slots = (unsigned char*)mem + header;
+    parent_pid = getpid();
+    fflush(NULL); // 子进程退出时不刷新继承来的缓冲，这里先清空，避免重复输出
+
+    for (int r = 1; r < process_count; r++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            process_rank = r;
+            stats_detach();
+            break;
+        }
+        if (pid < 0) {
+            fprintf(stderr, "无法创建第 %d 个模拟进程\n", r);
+            control->failed.store(1);
+            for (int k = 1; k < r; k++) waitpid(children[k], NULL, 0);
+            munmap(mem, shared_size);
+            process_count = 1;
+            return 0;
+        }
+        children[r] = pid;
+        reaped[r] = 0;
+    }
+    last_pass = now_seconds(); // 各进程从这里开始生成世界，第一回合的等待也计入
+    longest_tick = 0;
+
+    own_lo = band_count * process_rank / process_count;
+    own_hi = band_count * (process_rank + 1) / process_count;
+    set_band_range(own_lo > 0 ? own_lo - 1 : 0, own_hi < band_count ? own_hi + 1 : band_count);
+    return 1;
+#endif
+}
+
+#ifndef _WIN32
+// 主进程回收已退出的子进程；只有走完全部回合的子进程才会正常退出，其余情况都算失败
+static int children_alive() {
+    int ok = 1;
+    for (int r = 1; r < process_count; r++) {
+        if (reaped[r] || waitpid(children[r], &child_status[r], WNOHANG) <= 0) continue;
+        reaped[r] = 1;
+        if (!WIFEXITED(child_status[r]) || WEXITSTATUS(child_status[r]) != 0) ok = 0;
+    }
+    return ok;
+}
+
+// 两次通过栅栏之间的间隔，顺带更新最长间隔
+static void barrier_passed() {
+    double now = now_seconds();
+    if (now - last_pass > longest_tick) longest_tick = now - last_pass;
+    last_pass = now;
+}
+
+// 所有进程到齐后一起通过；等待时先自旋再让出 CPU，并留意其他进程是否已异常退出。
+// 进程卡住而没有退出（例如死锁）时不会被 waitpid 发现，因此还给等待设上限：
+// 超过 DOMAIN_STALL_SECONDS 加上最长一回合的 DOMAIN_STALL_FACTOR 倍仍未到齐，就当作有进程卡住
+static int domain_barrier() {
+    int phase = control->phase.load(std::memory_order_acquire);
+    if (control->arrived.fetch_add(1, std::memory_order_acq_rel) == process_count - 1) {
+        control->arrived.store(0, std::memory_order_relaxed);
+        control->phase.store(phase + 1, std::memory_order_release);
+        barrier_passed();
+        return 1;
+    }
+    double limit = DOMAIN_STALL_SECONDS + DOMAIN_STALL_FACTOR * longest_tick;
+    for (int spins = 1; control->phase.load(std::memory_order_acquire) == phase; spins++) {
+        if (spins < 64) continue;
+        sched_yield();
+        if (spins % 1024 != 0) continue;
+        if (control->failed.load()) return 0;
+        if (process_rank == 0 ? !children_alive() : getppid() != parent_pid) {
+            control->failed.store(1);
+            return 0;
+        }
+        if (now_seconds() - last_pass > limit) {
+            fprintf(stderr, "多进程模式：第 %d 回合等待其他进程超过 %.0f 秒，可能有进程卡住\n", tick + 1, limit);
+            control->failed.store(1);
+            return 0;
+        }
+    }
+    barrier_passed();
+    return 1;
+}
+
+// 有进程异常退出：子进程直接退出，主进程结束其余子进程
+static int domain_abort() {
+    if (process_rank != 0) _exit(1);
+    fprintf(stderr, "多进程模式：有模拟进程异常退出\n");
+    for (int r = 1; r < process_count; r++) {
+        if (reaped[r]) continue;
+        kill(children[r], SIGKILL); // 卡住或被暂停的进程也能结束
+        waitpid(children[r], NULL, 0);
+        reaped[r] = 1;
+    }
+    return 0;
+}
+#endif
+
+// 每回合 update_entities 之后调用：发布本进程首尾两条带和合计，读入两侧的边界带，
+// 并把全局数量、事件数与分布写回各统计变量，之后 record_tick_stats 照常使用
+int domain_exchange() {
+    if (process_count == 1) return 1;
+#ifdef _WIN32
+    return 0;
+#else
+    int parity = tick & 1;
+    DomainTotals* mine = &control->totals[parity][process_rank];
+    memset(mine, 0, sizeof(*mine));
+    mine->densest_tile = -1;
+    for (int b = own_lo; b < own_hi; b++) {
+        mine->grass += bands[b].grass;
+        for (int s = 0; s < ANIMAL_SPECIES; s++) {
+            mine->counts[s] += bands[b].animals[s].count;
+            mine->births[s] += bands[b].births[s];
+            mine->deaths[s] += bands[b].deaths[s];
+            mine->predations[s] += bands[b].predations[s];
+            census_add(&mine->census[s], &bands[b].census[s]);
+        }
+        if (bands[b].densest_animals > mine->densest_animals) {
+            mine->densest_animals = bands[b].densest_animals;
+            mine->densest_tile = bands[b].densest_tile;
+        }
+    }
+    mine->chunks = chunks_allocated;
+    save_band_state(own_lo, slot(process_rank, 0, parity));
+    save_band_state(own_hi - 1, slot(process_rank, 1, parity));
+    if (!domain_barrier()) return domain_abort();
+
+    if (process_rank > 0) load_band_state(own_lo - 1, slot(process_rank - 1, 1, parity));
+    if (process_rank < process_count - 1) load_band_state(own_hi, slot(process_rank + 1, 0, parity));
+    grass_count = 0;
+    for (int s = 0; s < ANIMAL_SPECIES; s++) species_count[s] = species_births[s] = species_deaths[s] = species_predations[s] = 0;
+    memset(census, 0, sizeof(census));
+    densest_tile = -1;
+    densest_animals = 0;
+    for (int r = 0; r < process_count; r++) {
+        const DomainTotals* t = &control->totals[parity][r];
+        grass_count += t->grass;
+        for (int s = 0; s < ANIMAL_SPECIES; s++) {
+            species_count[s] += t->counts[s];
+            species_births[s] += t->births[s];
+            species_deaths[s] += t->deaths[s];
+            species_predations[s] += t->predations[s];
+            census_add(&census[s], &t->census[s]);
+        }
+        if (t->densest_animals > densest_animals) {
+            densest_animals = t->densest_animals;
+            densest_tile = t->densest_tile;
+        }
+    }
+    last_parity = parity;
+    return 1;
+#endif
+}
+
+// 最后一回合之后调用：子进程在这里退出；主进程等待子进程，把各进程的区块数合计到 chunks_allocated。
+// 本进程的世界只有自己那一段是完整的，之后只能使用汇总过的数量
+int domain_finish() {
+    if (process_count == 1) return 1;
+#ifdef _WIN32
+    return 0;
+#else
+    if (process_rank != 0) _exit(0);
+    int ok = 1;
+    for (int r = 1; r < process_count; r++) {
+        if (!reaped[r]) waitpid(children[r], &child_status[r], 0);
+        reaped[r] = 1;
+        if (!WIFEXITED(child_status[r]) || WEXITSTATUS(child_status[r]) != 0) ok = 0;
+    }
+    if (!ok) fprintf(stderr, "多进程模式：有模拟进程异常退出\n");
+    if (last_parity >= 0) {
+        chunks_allocated = 0;
+        for (int r = 0; r < process_count; r++) chunks_allocated += control->totals[last_parity][r].chunks;
+    }
+    munmap(control, shared_size);
+    control = NULL;
+    return ok;
+#endif
+}
@@ -0,0 +1,17 @@
+﻿// 多进程分块：批处理时把地图按条带分给几个本机进程，每个进程只模拟自己的一段条带和两侧各一条边界带。
+// 每回合结束后，各进程把自己首尾两条带的完整状态（青草、计时、动物）写入共享内存，再读入相邻进程的
+// 首尾条带作为自己的边界带；越过分界的动物就这样迁入相邻进程。一回合内影响一个格子的范围不超过十几行
+// （搜索半径 6、移动与繁殖的冲突裁决各一两格），远小于条带高度 BAND_ROWS，边界带远端算错的部分
+// 在被覆盖前不会波及本进程的条带，因此结果与单进程逐位一致。全局数量每回合经共享内存汇总
+#pragma once
+
+#define DOMAIN_MAX_PROCS 256
+#define DOMAIN_STALL_SECONDS 60 // 栅栏等待的上限：这么多秒再加上最长一回合的 DOMAIN_STALL_FACTOR 倍
+#define DOMAIN_STALL_FACTOR 20
+
+extern int process_count; // 参与模拟的进程数，1 表示不分块
+extern int process_rank;  // 本进程的编号，0 为主进程（负责输出）
+
+int domain_start(int procs);
+int domain_exchange();
+int domain_finish();
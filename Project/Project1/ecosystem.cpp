@@ -0,0 +1,1835 @@
+﻿#define _CRT_SECURE_NO_WARNINGS
+#include "ecosystem.h"
+#include "profile.h"
+#include "history.h"
+#include "species.h"
+#include "density.h"
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+int grid_w = DEFAULT_GRID_SIZE, grid_h = DEFAULT_GRID_SIZE;
+// 区块表：每个区块含前/后双缓冲的动物格子，grid_front 为当前世界的一份，
+// update_entities 写入另一份，回合末翻转。只有动物附近的区块才分配（prepare_chunks），
+// 其余为 NULL；格子是否有动物一律以位平面为准
+Chunk** chunks = NULL;
+int chunk_count = 0, chunks_allocated = 0;
+int grid_front = 0;
+static_assert(BAND_ROWS == CHUNK_SIZE, "每条带正好是一行区块");
+
+// 每个区块的状态，按条带划分，只由处理该条带的线程写
+int* chunk_animals = NULL; // 当前世界中的动物数
+int* chunk_idle = NULL;    // 区块及其四周连续没有动物的回合数
+int* chunk_quiet = NULL;   // 连续长满青草且没有动物的回合数，达到 CHUNK_SLEEP_TICKS 即休眠
+int* tile_grass = NULL;    // 青草数，随长草与被吃增减
+int* tile_species[ANIMAL_SPECIES] = { NULL }; // 各物种的数量，回合末与 chunk_animals 一同统计
+
+// 每个物种一张位平面。动物平面按物种编号，与动物格子一起双缓冲；
+// 青草只有一份，配合每格一个字节的生长计时（饱和到 255）
+int plane_words = 0; // 每行的 64 位字数
+unsigned long long* grass_bits = NULL;
+unsigned long long* species_bits[ANIMAL_SPECIES] = { NULL };     // 当前世界
+unsigned long long* new_species_bits[ANIMAL_SPECIES] = { NULL }; // 下一回合
+unsigned char* grass_timer = NULL;
+
+Band* bands = NULL;
+int band_count = 0;
+int band_lo = 0, band_hi = 0; // 本进程模拟的条带 [band_lo, band_hi)；多进程模式下只是地图的一段（见 domain.h）
+
+// 每回合的移动意图，以动物在前缓冲中的格子为下标。每格只占 1 字节，与青草计时一样整图分配，
+// 裁决冲突时要查看四周的格子，整图数组比跨区块查找快得多
+unsigned char* move_dir = NULL;
+int tick_serial = 0; // 每回合递增，配合区块中的 birth_stamp 使用
+
+const int dir_dx[9] = { -1, -1, -1, 0, 0, 0, 1, 1, 1 };
+const int dir_dy[9] = { -1, 0, 1, -1, 0, 1, -1, 0, 1 };
+
+// 最近目标场，以目标类型为下标（青草或作为食物的动物），供所有吃它的物种使用；第一次需要建场时才分配
+NearestInfo* nearest_field[ENTITY_TYPES] = { NULL };
+int nearest_ready[ENTITY_TYPES] = { 0 };
+int species_count[ANIMAL_SPECIES] = { 0 }, grass_count = 0;
+int species_births[ANIMAL_SPECIES] = { 0 }, species_deaths[ANIMAL_SPECIES] = { 0 }; // 上一回合的事件数
+int species_predations[ANIMAL_SPECIES] = { 0 };
+int tick = 0;
+int season = 0;
+int start_season = 0; // 用户选择的起始季节
+const char* season_names[4] = { "春季", "夏季", "秋季", "冬季" };
+
+
+// 以下由 clear_world 与 initialize_grid（或 load_checkpoint）设置
+int species_max[ANIMAL_SPECIES];
+int species_min[ANIMAL_SPECIES];          // 不计 0，INT_MAX 表示还没有过
+int species_extinct_tick[ANIMAL_SPECIES]; // 种群首次归零的回合，-1 表示尚未灭绝
+long long species_sum[ANIMAL_SPECIES], sum_grass = 0; // 用于计算平均数量
+int stat_ticks = 0;
+SpeciesCensus census[ANIMAL_SPECIES];
+int densest_tile = -1, densest_animals = 0;
+
+int init_grass = 250;
+
+// 各物种的初始数量与繁殖参数（每回合的繁殖概率与所需的最低能量），与 SPECIES 同序
+int species_init[ANIMAL_SPECIES] = { 50, 0, 0 };
+double species_breed_prob[ANIMAL_SPECIES] = { 0.35, 0.20, 0.25 };
+int species_breed_energy[ANIMAL_SPECIES] = { 22, 35, 28 };
+
+// 青草的抽样方式：0 = 每个空格各抽一次；1 = 按几何分布直接跳到下一个长草的空格。
+// 两者的分布相同，但随机数序列不同，同一种子的结果只在同一方式下可以复现
+int grass_skip = 0;
+
+unsigned int rand_seed = 0;
+
+// 统计输出：模拟线程把记录放入单生产者单消费者的无锁环，后台线程取出后格式化写盘，
+// 模拟线程只有在环满（写盘长期跟不上）时才会等待
+#define STATS_LINE_MAX (64 + ANIMAL_SPECIES * 48) // CSV 一条记录的最大字节数
+FILE* stats_file = NULL;
+int stats_binary = 0;
+TickStats* stats_ring = NULL;
+std::atomic<unsigned int> stats_head(0); // 只由模拟线程写
+std::atomic<unsigned int> stats_tail(0); // 只由写盘线程写
+std::atomic<int> stats_done(0);
+std::thread stats_writer;
+long long stats_stalls = 0;
+
+// 计数器式随机数（Squares 算法）：没有内部状态，每次抽样只由 (种子, 回合, 格子, 用途) 决定，
+// 与求值顺序和线程数无关，相同种子的运行结果完全一致。每种用途使用由种子派生的独立密钥
+#define RNG_BIRTH_ATTEMPTS 12 // 放置后代的最多尝试次数，每次尝试占用一个用途编号
+// 新增的用途只能加在最后，否则之前各用途的密钥都会改变
+enum {
+    RNG_WALK = 0, RNG_BREED, RNG_GRASS, RNG_SPAWN, RNG_BIRTH,
+    RNG_GRASS_SKIP = RNG_BIRTH + RNG_BIRTH_ATTEMPTS, RNG_SPAWN_REGION, RNG_SPAWN_CELL, RNG_SPAWN_ORDER,
+    RNG_PURPOSES
+};
+unsigned long long rng_keys[RNG_PURPOSES];
+
+void rng_init(unsigned int seed) {
+    unsigned long long z = seed;
+    for (int k = 0; k < RNG_PURPOSES; k++) {
+        z += 0x9E3779B97F4A7C15ULL;
+        unsigned long long key = z;
+        key = (key ^ (key >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        key = (key ^ (key >> 27)) * 0x94D049BB133111EBULL;
+        rng_keys[k] = (key ^ (key >> 31)) | 1;
+    }
+}
+
+static inline unsigned int rng_draw(int purpose, unsigned long long ctr) {
+    PROF_COUNT(PROF_RNG_DRAWS);
+    unsigned long long key = rng_keys[purpose];
+    unsigned long long x = ctr * key, y = x, z = y + key;
+    x = x * x + y; x = (x >> 32) | (x << 32);
+    x = x * x + z; x = (x >> 32) | (x << 32);
+    x = x * x + y; x = (x >> 32) | (x << 32);
+    return (unsigned int)((x * x + z) >> 32);
+}
+
+// 本回合 cell 格子在某用途下的随机数
+static inline unsigned int cell_random(int cell, int purpose) {
+    return rng_draw(purpose, (unsigned long long)(unsigned)tick << 32 | (unsigned)cell);
+}
+
+// 把一次抽样映射到 [0, n)：乘法取高 32 位代替取模，省去除法
+static inline unsigned int rng_below(unsigned int draw, unsigned int n) {
+    return (unsigned int)(((unsigned long long)draw * n) >> 32);
+}
+
+// 把概率换成 32 位阈值：draw < threshold 的概率即为 prob，省去浮点除法
+static inline unsigned int rng_threshold(double prob) {
+    return prob >= 1.0 ? 0xFFFFFFFFu : (unsigned int)(prob * 4294967296.0);
+}
+
+double now_seconds() {
+#ifdef _WIN32
+    LARGE_INTEGER freq, counter;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+// 分配第 k 个区块；新区块全部为空格子
+static void ensure_chunk(size_t k) {
+    if (chunks[k]) return;
+    chunks[k] = (Chunk*)calloc(1, sizeof(Chunk));
+    if (!chunks[k]) {
+        fprintf(stderr, "内存不足：无法分配第 %d 个区块\n", chunks_allocated + 1);
+        exit(1);
+    }
+    chunks_allocated++;
+}
+
+static void free_chunks() {
+    for (int k = 0; chunks && k < chunk_count; k++) {
+        free(chunks[k]);
+        chunks[k] = NULL;
+    }
+    chunks_allocated = 0;
+}
+
+// (x, y) 处的动物格子。side 取 grid_front 为当前世界，取 grid_front ^ 1 为下一回合；区块必须已分配
+static inline Entity* entity_xy(int side, int x, int y) {
+    return &chunks[CHUNK_INDEX(x, y)]->cells[side][CHUNK_OFFSET(x, y)];
+}
+
+static inline Entity* entity_at(int side, int cell) {
+    return entity_xy(side, cell / grid_w, cell % grid_w);
+}
+
+// 唤醒第 b 条带中有动物的区块
+static void wake_band_chunks(int b) {
+    const int* count = &chunk_animals[(size_t)b * plane_words];
+    for (int k = 0; k < plane_words; k++) {
+        if (count[k]) chunk_quiet[(size_t)b * plane_words + k] = 0;
+    }
+}
+
+// 按个体列表统计第 b 条带各区块中的动物数、各物种的数量，以及动物最多的区块
+static void count_band_tiles(int b) {
+    Band* band = &bands[b];
+    int* count = &chunk_animals[(size_t)b * plane_words];
+    memset(count, 0, plane_words * sizeof(int));
+    for (int s = 0; s < ANIMAL_SPECIES; s++) {
+        int* tiles = &tile_species[s][(size_t)b * plane_words];
+        const AgentList* list = &band->animals[s];
+        memset(tiles, 0, plane_words * sizeof(int));
+        for (int k = 0; k < list->count; k++) tiles[(list->cells[k] % grid_w) >> CHUNK_SHIFT]++;
+        for (int k = 0; k < plane_words; k++) count[k] += tiles[k];
+    }
+    band->densest_tile = -1;
+    band->densest_animals = 0;
+    for (int k = 0; k < plane_words; k++) {
+        if (count[k] > band->densest_animals) {
+            band->densest_animals = count[k];
+            band->densest_tile = b * plane_words + k;
+        }
+    }
+    wake_band_chunks(b);
+}
+
+// 把一个个体的能量、年龄计入分布 (n = 1) 或从中移除 (n = -1)
+static inline void census_energy(SpeciesCensus* c, int energy, int n) {
+    int k = energy / CENSUS_ENERGY_STEP;
+    c->energy[k < CENSUS_BINS ? k : CENSUS_BINS - 1] += n;
+    c->energy_sum += (long long)n * energy;
+}
+
+static inline void census_animal(SpeciesCensus* c, int energy, int age) {
+    int k = age / CENSUS_AGE_STEP;
+    c->count++;
+    c->age[k < CENSUS_BINS ? k : CENSUS_BINS - 1]++;
+    c->age_sum += age;
+    census_energy(c, energy, 1);
+}
+
+// 读档或交换边界带之后按当前世界的动物格子重新统计第 b 条带的分布；
+// 回合中的分布则由移动与繁殖的内核逐个事件累加（见 update_entities）
+static void census_band(int b) {
+    for (int s = 0; s < ANIMAL_SPECIES; s++) {
+        SpeciesCensus* c = &bands[b].census[s];
+        const AgentList* list = &bands[b].animals[s];
+        memset(c, 0, sizeof(*c));
+        for (int k = 0; k < list->count; k++) {
+            Entity e = *entity_at(grid_front, list->cells[k]);
+            census_animal(c, ENTITY_ENERGY(e), ENTITY_AGE(e));
+        }
+    }
+    count_band_tiles(b);
+}
+
+// 只分配位平面、青草计时、移动意图和区块表这些每格不超过 2 字节的数据，动物格子按区块另行分配
+int alloc_world() {
+    size_t cells = (size_t)grid_w * grid_h;
+    move_dir = (unsigned char*)malloc(cells);
+    plane_words = (grid_w + 63) / 64;
+    size_t words = (size_t)grid_h * plane_words;
+    grass_bits = (unsigned long long*)calloc(words, sizeof(unsigned long long));
+    int planes_ok = 1;
+    for (int s = 0; s < ANIMAL_SPECIES; s++) {
+        species_bits[s] = (unsigned long long*)calloc(words, sizeof(unsigned long long));
+        new_species_bits[s] = (unsigned long long*)calloc(words, sizeof(unsigned long long));
+        planes_ok = planes_ok && species_bits[s] && new_species_bits[s];
+    }
+    grass_timer = (unsigned char*)calloc(cells, 1);
+    band_count = (grid_h + BAND_ROWS - 1) / BAND_ROWS;
+    band_lo = 0;
+    band_hi = band_count;
+    bands = (Band*)calloc(band_count, sizeof(Band));
+    chunk_count = band_count * plane_words;
+    chunks = (Chunk**)calloc(chunk_count, sizeof(Chunk*));
+    chunk_animals = (int*)calloc(chunk_count, sizeof(int));
+    chunk_idle = (int*)calloc(chunk_count, sizeof(int));
+    chunk_quiet = (int*)calloc(chunk_count, sizeof(int));
+    tile_grass = (int*)calloc(chunk_count, sizeof(int));
+    for (int s = 0; s < ANIMAL_SPECIES; s++) {
+        tile_species[s] = (int*)calloc(chunk_count, sizeof(int));
+        planes_ok = planes_ok && tile_species[s];
+    }
+    chunks_allocated = 0;
+    if (!move_dir || !bands || !chunks || !chunk_animals || !chunk_idle || !chunk_quiet || !tile_grass
+        || !grass_bits || !planes_ok || !grass_timer) {
+        free_world();
+        return 0;
+    }
+    return 1;
+}
+
+void free_world() {
+    free_chunks();
+    free(chunks);
+    free(chunk_animals);
+    free(chunk_idle);
+    free(chunk_quiet);
+    free(tile_grass);
+    chunks = NULL;
+    chunk_animals = chunk_idle = chunk_quiet = tile_grass = NULL;
+    chunk_count = 0;
+    for (int t = 0; t < ENTITY_TYPES; t++) {
+        free(nearest_field[t]);
+        nearest_field[t] = NULL;
+    }
+    free(move_dir);
+    move_dir = NULL;
+    free(grass_bits);
+    grass_bits = NULL;
+    for (int s = 0; s < ANIMAL_SPECIES; s++) {
+        free(species_bits[s]);
+        free(new_species_bits[s]);
+        free(tile_species[s]);
+        species_bits[s] = new_species_bits[s] = NULL;
+        tile_species[s] = NULL;
+    }
+    free(grass_timer);
+    grass_timer = NULL;
+    for (int b = 0; bands && b < band_count; b++) {
+        for (int s = 0; s < ANIMAL_SPECIES; s++) {
+            list_free(&bands[b].animals[s]);
+            list_free(&bands[b].moved[s]);
+            list_free(&bands[b].born[s]);
+            list_free(&bands[b].breeders[s]);
+        }
+        list_free(&bands[b].eaten);
+    }
+    free(bands);
+    bands = NULL;
+    band_count = 0;
+}
+
+void list_push(AgentList* list, int cell) {
+    if (list->count == list->capacity) {
+        int capacity = list->capacity ? list->capacity * 2 : 256;
+        int* cells = (int*)realloc(list->cells, capacity * sizeof(int));
+        if (!cells) {
+            fprintf(stderr, "内存不足：个体列表无法扩展到 %d\n", capacity);
+            exit(1);
+        }
+        list->cells = cells;
+        list->capacity = capacity;
+    }
+    list->cells[list->count++] = cell;
+}
+
+void list_free(AgentList* list) {
+    free(list->cells);
+    list->cells = NULL;
+    list->count = list->capacity = 0;
+}
+
+int compare_cells(const void* a, const void* b) {
+    int ca = *(const int*)a, cb = *(const int*)b;
+    return (ca > cb) - (ca < cb);
+}
+
+void list_sort(AgentList* list) {
+    qsort(list->cells, list->count, sizeof(int), compare_cells);
+}
+
+AgentList* species_list(Band* band, EntityType type) {
+    return &band->animals[SPECIES_OF(type)];
+}
+
+// 当前世界中某物种的位平面
+const unsigned long long* species_plane(EntityType type) {
+    return type == GRASS ? grass_bits : species_bits[SPECIES_OF(type)];
+}
+
+static inline int popcount64(unsigned long long v) {
+#if defined(_MSC_VER) && defined(_M_X64)
+    return (int)__popcnt64(v);
+#elif defined(_MSC_VER)
+    return (int)(__popcnt((unsigned int)v) + __popcnt((unsigned int)(v >> 32)));
+#else
+    return __builtin_popcountll(v);
+#endif
+}
+
+static inline int lowest_bit64(unsigned long long v) {
+#if defined(_MSC_VER) && defined(_M_X64)
+    unsigned long idx;
+    _BitScanForward64(&idx, v);
+    return (int)idx;
+#elif defined(_MSC_VER)
+    unsigned long idx;
+    if (_BitScanForward(&idx, (unsigned long)v)) return (int)idx;
+    _BitScanForward(&idx, (unsigned long)(v >> 32));
+    return (int)idx + 32;
+#else
+    return __builtin_ctzll(v);
+#endif
+}
+
+// 用 popcount 重新统计第 b 条带各区块的青草数，只在整体写入青草位平面（放置、读档、交换边界带）后调用
+static void count_band_grass(int b) {
+    int row_end = (b + 1) * BAND_ROWS < grid_h ? (b + 1) * BAND_ROWS : grid_h;
+    bands[b].grass = 0;
+    for (int k = 0; k < plane_words; k++) {
+        int count = 0;
+        for (int i = b * BAND_ROWS; i < row_end; i++) count += popcount64(PLANE_WORD(grass_bits, i, k * 64));
+        tile_grass[(size_t)b * plane_words + k] = count;
+        bands[b].grass += count;
+    }
+}
+
+void census_add(SpeciesCensus* to, const SpeciesCensus* from) {
+    to->count += from->count;
+    to->energy_sum += from->energy_sum;
+    to->age_sum += from->age_sum;
+    for (int k = 0; k < CENSUS_BINS; k++) {
+        to->energy[k] += from->energy[k];
+        to->age[k] += from->age[k];
+    }
+}
+
+// 汇总本进程各条带的分布与最密区块；条带顺序固定，编号最小的区块在并列时胜出
+static void census_total() {
+    memset(census, 0, sizeof(census));
+    densest_tile = -1;
+    densest_animals = 0;
+    for (int b = band_lo; b < band_hi; b++) {
+        for (int s = 0; s < ANIMAL_SPECIES; s++) census_add(&census[s], &bands[b].census[s]);
+        if (bands[b].densest_animals > densest_animals) {
+            densest_animals = bands[b].densest_animals;
+            densest_tile = bands[b].densest_tile;
+        }
+    }
+}
+
+// 每回合结束时记录历史曲线与极值
+void record_tick_stats() {
+    history_add(species_count);
+
+    for (int s = 0; s < ANIMAL_SPECIES; s++) {
+        int n = species_count[s];
+        if (n > species_max[s]) species_max[s] = n;
+        if (n > 0 && n < species_min[s]) species_min[s] = n;
+        // 本回合结束时已完成 tick + 1 回合
+        if (n == 0 && species_extinct_tick[s] < 0) species_extinct_tick[s] = tick + 1;
+        species_sum[s] += n;
+    }
+    sum_grass += grass_count;
+    stat_ticks++;
+
+    if (stats_file) {
+        TickStats rec;
+        rec.tick = tick + 1;
+        rec.season = season;
+        rec.grass = grass_count;
+        memcpy(rec.counts, species_count, sizeof(rec.counts));
+        memcpy(rec.births, species_births, sizeof(rec.births));
+        memcpy(rec.deaths, species_deaths, sizeof(rec.deaths));
+        memcpy(rec.predations, species_predations, sizeof(rec.predations));
+        stats_push(&rec);
+    }
+}
+
+// CSV 的一条记录；列的顺序与 stats_open 写的表头一致，捕食次数只对捕食者输出
+static size_t format_tick_stats(char* out, size_t size, const TickStats* r) {
+    size_t len = snprintf(out, size, "%d,%d,%d", r->tick, r->season, r->grass);
+    for (int s = 0; s < ANIMAL_SPECIES; s++) len += snprintf(out + len, size - len, ",%d", r->counts[s]);
+    for (int s = 0; s < ANIMAL_SPECIES; s++) len += snprintf(out + len, size - len, ",%d", r->births[s]);
+    for (int s = 0; s < ANIMAL_SPECIES; s++) len += snprintf(out + len, size - len, ",%d", r->deaths[s]);
+    for (int s = 0; s < ANIMAL_SPECIES; s++) {
+        if (SPECIES[s].food != GRASS) len += snprintf(out + len, size - len, ",%d", r->predations[s]);
+    }
+    len += snprintf(out + len, size - len, "\n");
+    return len;
+}
+
+// 写盘线程：成批取出环中的记录，格式化到缓冲区后写入文件
+static void stats_writer_main() {
+    static char buf[1 << 16];
+    size_t len = 0;
+    for (;;) {
+        int done = stats_done.load(std::memory_order_acquire); // 先读结束标志，保证不漏掉最后的记录
+        unsigned int tail = stats_tail.load(std::memory_order_relaxed);
+        unsigned int head = stats_head.load(std::memory_order_acquire);
+        if (tail == head) {
+            if (done) break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+        for (; tail != head; tail++) {
+            const TickStats* r = &stats_ring[tail & (STATS_RING_SIZE - 1)];
+            if (len + STATS_LINE_MAX > sizeof(buf)) {
+                fwrite(buf, 1, len, stats_file);
+                len = 0;
+            }
+            if (stats_binary) {
+                memcpy(buf + len, r, sizeof(*r));
+                len += sizeof(*r);
+            }
+            else {
+                len += format_tick_stats(buf + len, sizeof(buf) - len, r);
+            }
+        }
+        stats_tail.store(tail, std::memory_order_release);
+        fwrite(buf, 1, len, stats_file);
+        len = 0;
+    }
+}
+
+// 打开统计文件并启动写盘线程；文件名以 .bin 结尾时写二进制，否则写 CSV
+int stats_open(const char* path) {
+    size_t n = strlen(path);
+    stats_binary = n >= 4 && strcmp(path + n - 4, ".bin") == 0;
+    stats_ring = (TickStats*)malloc(STATS_RING_SIZE * sizeof(TickStats));
+    stats_file = stats_ring ? fopen(path, stats_binary ? "wb" : "w") : NULL;
+    if (!stats_file) {
+        free(stats_ring);
+        stats_ring = NULL;
+        return 0;
+    }
+    if (stats_binary) {
+        // 文件头：魔数、版本、每条记录的字节数、物种数，之后是 TickStats 记录
+        unsigned int info[3] = { 2, (unsigned int)sizeof(TickStats), ANIMAL_SPECIES };
+        fwrite("ECOSTAT", 1, 8, stats_file);
+        fwrite(info, sizeof(info), 1, stats_file);
+    }
+    else {
+        fprintf(stats_file, "tick,season,grass");
+        for (int s = 0; s < ANIMAL_SPECIES; s++) fprintf(stats_file, ",%s", SPECIES[s].key);
+        for (int s = 0; s < ANIMAL_SPECIES; s++) fprintf(stats_file, ",%s_births", SPECIES[s].prefix);
+        for (int s = 0; s < ANIMAL_SPECIES; s++) fprintf(stats_file, ",%s_deaths", SPECIES[s].prefix);
+        for (int s = 0; s < ANIMAL_SPECIES; s++) {
+            if (SPECIES[s].food != GRASS) fprintf(stats_file, ",%s_predations", SPECIES[s].prefix);
+        }
+        fprintf(stats_file, "\n");
+    }
+    stats_head.store(0);
+    stats_tail.store(0);
+    stats_done.store(0);
+    stats_stalls = 0;
+    stats_writer = std::thread(stats_writer_main);
+    return 1;
+}
+
+// 由模拟线程调用：放入一条记录，环满时让出 CPU 等待写盘线程
+void stats_push(const TickStats* rec) {
+    unsigned int head = stats_head.load(std::memory_order_relaxed);
+    while (head - stats_tail.load(std::memory_order_acquire) >= STATS_RING_SIZE) {
+        stats_stalls++;
+        std::this_thread::yield();
+    }
+    stats_ring[head & (STATS_RING_SIZE - 1)] = *rec;
+    stats_head.store(head + 1, std::memory_order_release);
+}
+
+// fork 出的子进程不写统计：写盘线程没有随 fork 复制，直接丢下继承来的文件和环，不刷新也不关闭
+void stats_detach() {
+    stats_file = NULL;
+    stats_ring = NULL;
+}
+
+// 等写盘线程写完剩余记录后关闭文件
+void stats_close() {
+    if (!stats_file) return;
+    stats_done.store(1, std::memory_order_release);
+    stats_writer.join();
+    fclose(stats_file);
+    stats_file = NULL;
+    free(stats_ring);
+    stats_ring = NULL;
+    if (stats_stalls > 0)
+        fprintf(stderr, "统计输出：写盘跟不上模拟，模拟线程共等待 %lld 次\n", stats_stalls);
+}
+
+// 清空世界与统计，不放置任何个体
+void clear_world() {
+    // 已分配的区块留给新世界：按两份动物位平面清空动物格子即可，用不到的区块之后由 prepare_chunks 释放
+    for (int i = 0; i < grid_h; i++) {
+        for (int k = 0; k < plane_words; k++) {
+            for (int side = 0; side < 2; side++) {
+                unsigned long long bits = 0;
+                for (int s = 0; s < ANIMAL_SPECIES; s++)
+                    bits |= PLANE_WORD(side == grid_front ? species_bits[s] : new_species_bits[s], i, k * 64);
+                while (bits) {
+                    *entity_xy(side, i, k * 64 + lowest_bit64(bits)) = EMPTY;
+                    bits &= bits - 1;
+                }
+            }
+        }
+    }
+    memset(chunk_animals, 0, chunk_count * sizeof(int));
+    memset(chunk_idle, 0, chunk_count * sizeof(int));
+    memset(chunk_quiet, 0, chunk_count * sizeof(int));
+    memset(tile_grass, 0, chunk_count * sizeof(int));
+    size_t words = (size_t)grid_h * plane_words;
+    memset(grass_bits, 0, words * sizeof(unsigned long long));
+    for (int s = 0; s < ANIMAL_SPECIES; s++) {
+        memset(species_bits[s], 0, words * sizeof(unsigned long long));
+        memset(new_species_bits[s], 0, words * sizeof(unsigned long long));
+        memset(tile_species[s], 0, chunk_count * sizeof(int));
+        species_count[s] = 0;
+        species_max[s] = 0;
+        species_min[s] = INT_MAX;
+        species_sum[s] = 0;
+        for (int b = 0; b < band_count; b++) {
+            bands[b].animals[s].count = 0;
+            memset(&bands[b].census[s], 0, sizeof(SpeciesCensus));
+        }
+    }
+    for (int b = 0; b < band_count; b++) {
+        bands[b].grass = 0;
+        bands[b].densest_tile = -1;
+        bands[b].densest_animals = 0;
+    }
+    grass_count = 0;
+    memset(census, 0, sizeof(census));
+    densest_tile = -1;
+    densest_animals = 0;
+    sum_grass = 0;
+    stat_ticks = 0;
+    history_reset(0);
+}
+
+void initialize_grid() {
+    clear_world();
+    spawn_world();
+    for (int s = 0; s < ANIMAL_SPECIES; s++)
+        species_extinct_tick[s] = species_count[s] == 0 ? 0 : -1; // 一开始就没有的物种记为第 0 回合灭绝
+    // spawn_world 生成的个体列表已按格子编号排好序；各条带的统计互不相干，可以并行
+#pragma omp parallel for schedule(dynamic)
+    for (int b = 0; b < band_count; b++) {
+        census_band(b);
+        count_band_grass(b);
+    }
+    census_total();
+
+    // 设置初始季节
+    season = start_season;
+    tick = 0;
+}
+
+// 世界生成用的矩形区域：不跨条带，区域内各类型的密度都相同
+typedef struct {
+    int x0, y0, rows, cols;
+    int capacity;             // 还没分出去的格子数
+    int demand[ENTITY_TYPES]; // 分到本区域的各类个体数，EMPTY 不用
+    int drawn;                // 本轮抽样分到的个数，还没按容量截断
+} SpawnRegion;
+
+// 区域内 type 的密度；没有密度图的类型处处为 1
+static double region_density(const SpawnRegion* r, int type) {
+    const DensityMap* map = &density_maps[type];
+    if (!map->rows) return 1.0;
+    return map->weights[(size_t)((long long)r->x0 * map->rows / grid_h) * map->cols + (long long)r->y0 * map->cols / grid_w];
+}
+
+// 把 n 行（by_rows = 1）或 n 列切成若干段，在条带的第一行和任意一张密度图换格的地方断开。
+// starts 收到各段的起点，末尾再补一个 n；返回段数
+static int spawn_segments(int n, int by_rows, int* starts) {
+    int count = 0;
+    for (int i = 0; i < n; i++) {
+        int cut = i == 0 || (by_rows && i % BAND_ROWS == 0);
+        for (int t = GRASS; t < ENTITY_TYPES && !cut; t++) {
+            int m = by_rows ? density_maps[t].rows : density_maps[t].cols;
+            if (m && (long long)i * m / n != (long long)(i - 1) * m / n) cut = 1;
+        }
+        if (cut) starts[count++] = i;
+    }
+    starts[count] = n;
+    return count;
+}
+
+// 二项分布 B(n, p) 的一次抽样（逆变换法）：从众数出发向两侧交替累加概率，直到超过均匀抽样值，
+// 步数与标准差同阶
+static int spawn_binomial(int n, double p, unsigned long long ctr) {
+    if (n <= 0 || p <= 0.0) return 0;
+    if (p >= 1.0) return n;
+    double u = (rng_draw(RNG_SPAWN_REGION, ctr) + 0.5) * (1.0 / 4294967296.0);
+    int mode = (int)((n + 1.0) * p);
+    if (mode > n) mode = n;
+    double ratio = p / (1.0 - p);
+    double pm = exp(lgamma(n + 1.0) - lgamma(mode + 1.0) - lgamma(n - mode + 1.0) + mode * log(p) + (n - mode) * log1p(-p));
+    u -= pm;
+    if (u <= 0) return mode;
+    int lo = mode, hi = mode;
+    double p_lo = pm, p_hi = pm;
+    while ((lo > 0 && p_lo > 0) || (hi < n && p_hi > 0)) {
+        if (lo > 0) {
+            p_lo *= lo / ((n - lo + 1.0) * ratio);
+            lo--;
+            u -= p_lo;
+            if (u <= 0) return lo;
+        }
+        if (hi < n) {
+            p_hi *= (n - hi) * ratio / (hi + 1.0);
+            hi++;
+            u -= p_hi;
+            if (u <= 0) return hi;
+        }
+    }
+    return mode; // 只剩舍入误差
+}
+
+// 把 count 个个体按多项分布分给区域 [lo, hi)（权重见 cum）：按左右两半的权重之比抽一次二项分布，
+// 再分别递归，抽样次数与区域数成正比而与个体数无关。node 为二叉树中的编号，与 type、round 一起决定计数器
+static void spawn_split(SpawnRegion* regions, const double* cum, int lo, int hi, int count,
+    int type, unsigned long long round, unsigned long long node) {
+    if (count == 0) return;
+    if (hi - lo == 1) {
+        regions[lo].drawn = count;
+        return;
+    }
+    int mid = (lo + hi) / 2;
+    double base = lo > 0 ? cum[lo - 1] : 0.0;
+    double all = cum[hi - 1] - base;
+    int left = spawn_binomial(count, all > 0 ? (cum[mid - 1] - base) / all : 0.0,
+        (unsigned long long)type << 56 | round << 40 | node);
+    spawn_split(regions, cum, lo, mid, left, type, round, node * 2);
+    spawn_split(regions, cum, mid, hi, count - left, type, round, node * 2 + 1);
+}
+
+// 按 密度 x 剩余格数 把 type 的 count 个个体分给各区域（每个个体独立选区域时各区域个数的分布）。
+// 超出区域容量的部分按剩余格数重新计算权重后再分一轮（已满的区域权重为 0），直到全部放下或地图已满。
+// 返回放不下的个数
+static int spawn_demand(SpawnRegion* regions, int n, double* cum, int type, int count) {
+    int excess = count;
+    for (unsigned long long round = 0; excess > 0; round++) {
+        double total = 0;
+        for (int r = 0; r < n; r++) {
+            total += regions[r].capacity > 0 ? region_density(&regions[r], type) * regions[r].capacity : 0.0;
+            cum[r] = total;
+            regions[r].drawn = 0;
+        }
+        if (total <= 0) break;
+        spawn_split(regions, cum, 0, n, excess, type, round, 1);
+        for (int r = 0; r < n; r++) {
+            int take = regions[r].drawn < regions[r].capacity ? regions[r].drawn : regions[r].capacity;
+            regions[r].demand[type] += take;
+            regions[r].capacity -= take;
+            excess -= take;
+        }
+    }
+    return excess;
+}
+
+// 在 (x, y) 放一个 t 类型的初始个体
+static inline void spawn_place(int x, int y, int t) {
+    if (t == GRASS) {
+        PLANE_SET(grass_bits, x, y);
+        CELL(grass_timer, x, y) = 0;
+        return;
+    }
+    int s = SPECIES_OF(t), cell = x * grid_w + y;
+    int max_age = SPECIES[s].age_base + rng_below(rng_draw(RNG_SPAWN, (unsigned)cell), SPECIES[s].age_spread);
+    *entity_xy(grid_front, x, y) = ENTITY_PACK(SPECIES[s].type, SPECIES[s].spawn_energy, 0, max_age);
+    PLANE_CLEAR(grass_bits, x, y);
+    PLANE_SET(species_bits[s], x, y);
+    list_push(&bands[x / BAND_ROWS].animals[s], cell);
+}
+
+// 按各类剩余的个数抽第 i 个格子的类型（remaining 为还没处理的格子数）。逐个这样抽，
+// 结果与把全部个体均匀分到这些格子上相同
+static inline int spawn_type(int* left, int ri, int i, int remaining) {
+    unsigned int u = rng_below(rng_draw(RNG_SPAWN_ORDER, (unsigned long long)ri << 32 | (unsigned)i), (unsigned)remaining);
+    int t = GRASS;
+    while (u >= (unsigned int)left[t]) u -= left[t++];
+    left[t]--;
+    return t;
+}
+
+// 在第 ri 个区域里选出分到的格子并放置个体。Floyd 算法：依次对 j = 面积-k .. 面积-1 抽 [0, j] 中的一个数，
+// 已选过就改选 j，k 次抽样得到 k 个互不相同的格子（借青草位平面标记已选）；再按位平面逐行取出，
+// 为每个格子抽类型。格子按编号升序处理，写入是顺序的，各物种的列表也已排好序
+static void spawn_region(const SpawnRegion* region, int ri) {
+    int area = region->rows * region->cols, k = 0;
+    int left[ENTITY_TYPES];
+    for (int t = GRASS; t < ENTITY_TYPES; t++) {
+        left[t] = region->demand[t];
+        k += left[t];
+    }
+    for (int j = area - k; j < area; j++) {
+        int c = (int)rng_below(rng_draw(RNG_SPAWN_CELL, (unsigned long long)ri << 32 | (unsigned)j), (unsigned)(j + 1));
+        int x = region->x0 + c / region->cols, y = region->y0 + c % region->cols;
+        if (PLANE_TEST(grass_bits, x, y)) {
+            x = region->x0 + j / region->cols;
+            y = region->y0 + j % region->cols;
+        }
+        PLANE_SET(grass_bits, x, y);
+    }
+
+    int x_end = region->x0 + region->rows, y_end = region->y0 + region->cols, i = 0;
+    for (int x = region->x0; x < x_end && i < k; x++) {
+        for (int y0 = region->y0 & ~63; y0 < y_end; y0 += 64) {
+            unsigned long long word = PLANE_WORD(grass_bits, x, y0);
+            if (y0 < region->y0) word &= ~0ULL << (region->y0 - y0);
+            if (y_end - y0 < 64) word &= (1ULL << (y_end - y0)) - 1;
+            for (; word; word &= word - 1, i++) spawn_place(x, y0 + lowest_bit64(word), spawn_type(left, ri, i, k - i));
+        }
+    }
+}
+
+// 在清空的世界中放置 init_grass 棵青草和各物种的初始个体，数量恰好等于要求（地图放不下时在标准错误说明）。
+// 地图按条带和密度图的网格切成矩形区域，先按多项分布把个体分给各区域，再在各区域内用 Floyd 抽样选格子，
+// 开销与个体数和区域数成正比，不逐格扫描地图；各条带的区域并行放置，结果与线程数无关。
+// 只放置本进程模拟的条带 [band_lo, band_hi)，数量仍是整张地图的合计（多进程时各进程各自生成，见 domain.h）
+void spawn_world() {
+    int* row_starts = (int*)malloc((grid_h + 1) * sizeof(int));
+    int* col_starts = (int*)malloc((grid_w + 1) * sizeof(int));
+    if (!row_starts || !col_starts) {
+        fprintf(stderr, "内存不足：无法生成世界\n");
+        exit(1);
+    }
+    int row_segs = spawn_segments(grid_h, 1, row_starts);
+    int col_segs = spawn_segments(grid_w, 0, col_starts);
+    int n = row_segs * col_segs;
+    SpawnRegion* regions = (SpawnRegion*)calloc(n, sizeof(SpawnRegion));
+    double* cum = (double*)malloc(n * sizeof(double));
+    int* band_first = (int*)malloc((band_count + 1) * sizeof(int)); // 各条带的第一个区域，区域按行段、列段排列
+    if (!regions || !cum || !band_first) {
+        fprintf(stderr, "内存不足：无法生成世界\n");
+        exit(1);
+    }
+    for (int i = 0; i < row_segs; i++) {
+        if (row_starts[i] % BAND_ROWS == 0) band_first[row_starts[i] / BAND_ROWS] = i * col_segs;
+        for (int j = 0; j < col_segs; j++) {
+            SpawnRegion* r = &regions[i * col_segs + j];
+            r->x0 = row_starts[i];
+            r->y0 = col_starts[j];
+            r->rows = row_starts[i + 1] - row_starts[i];
+            r->cols = col_starts[j + 1] - col_starts[j];
+            r->capacity = r->rows * r->cols;
+        }
+    }
+    band_first[band_count] = n;
+    free(row_starts);
+    free(col_starts);
+
+    const int* counts[ENTITY_TYPES] = { NULL, &init_grass };
+    for (int s = 0; s < ANIMAL_SPECIES; s++) counts[SPECIES[s].type] = &species_init[s];
+    for (int t = GRASS; t < ENTITY_TYPES; t++) {
+        int missing = spawn_demand(regions, n, cum, t, *counts[t]);
+        if (missing > 0) {
+            fprintf(stderr, "地图放不下全部%s：要求 %d，只放置了 %d\n",
+                t == GRASS ? "青草" : SPECIES[SPECIES_OF(t)].name, *counts[t], *counts[t] - missing);
+        }
+    }
+    free(cum);
+
+    // 区块表只能串行修改：先为分到动物的区域分配区块
+    for (int r = band_first[band_lo]; r < band_first[band_hi]; r++) {
+        int animals = 0;
+        for (int s = 0; s < ANIMAL_SPECIES; s++) animals += regions[r].demand[SPECIES[s].type];
+        if (!animals) continue;
+        for (int c = regions[r].y0 >> CHUNK_SHIFT; c <= (regions[r].y0 + regions[r].cols - 1) >> CHUNK_SHIFT; c++)
+            ensure_chunk((size_t)(regions[r].x0 / BAND_ROWS) * plane_words + c);
+    }
+#pragma omp parallel for schedule(dynamic)
+    for (int b = band_lo; b < band_hi; b++) {
+        for (int r = band_first[b]; r < band_first[b + 1]; r++) spawn_region(&regions[r], r);
+        // 一行切成多段时，条带的列表是各区域升序段的拼接，要再排一次序
+        if (col_segs > 1) {
+            for (int s = 0; s < ANIMAL_SPECIES; s++) list_sort(&bands[b].animals[s]);
+        }
+    }
+
+    for (int r = 0; r < n; r++) {
+        grass_count += regions[r].demand[GRASS];
+        for (int s = 0; s < ANIMAL_SPECIES; s++) species_count[s] += regions[r].demand[SPECIES[s].type];
+    }
+    free(band_first);
+    free(regions);
+}
+
+// 第 t 回合的季节：从 start_season 开始，每100回合换季
+int season_at(int t) {
+    return (start_season + t / 100) % 4;
+}
+
+void update_season() {
+    season = season_at(tick);
+}
+
+// 一行青草的生长计时统一加一（饱和到 255）。非草格子的计时没有意义，
+// 新长出的草随后清零，因此无需按位平面挑选格子，可以整行向量化
+static void grass_timer_tick(unsigned char* timer, int n) {
+    int j = 0;
+#if defined(__AVX2__)
+    const __m256i one = _mm256_set1_epi8(1);
+    for (; j + 32 <= n; j += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(timer + j));
+        _mm256_storeu_si256((__m256i*)(timer + j), _mm256_adds_epu8(v, one));
+    }
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+    const __m128i one16 = _mm_set1_epi8(1);
+    for (; j + 16 <= n; j += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(timer + j));
+        _mm_storeu_si128((__m128i*)(timer + j), _mm_adds_epu8(v, one16));
+    }
+#endif
+    for (; j < n; j++) {
+        if (timer[j] != 255) timer[j]++;
+    }
+}
+
+// 几何跳跃抽样：每个空格独立以 p 长草时，两次长草之间跳过的空格数服从几何分布，
+// 由一次抽样按反函数得到。log_keep = log(1-p)，返回值截断到 CHUNK_CELLS
+static inline int grass_gap(unsigned long long ctr, double log_keep) {
+    double u = (rng_draw(RNG_GRASS_SKIP, ctr) + 1.0) * (1.0 / 4294967296.0); // (0, 1]
+    double gap = log(u) / log_keep;
+    return gap < CHUNK_CELLS ? (int)gap : CHUNK_CELLS;
+}
+
+void update_grass() {
+    PROF_BEGIN(PROF_GRASS);
+    double spawn_prob = 0.0;
+    switch (season) {
+    case 0: spawn_prob = 0.12; break; // 春
+    case 1: spawn_prob = 0.10; break; // 夏
+    case 2: spawn_prob = 0.03; break; // 秋
+    case 3: spawn_prob = 0.005; break; // 冬
+    }
+
+    // 按条带并行、逐个区块处理，每行一个 64 格的字：空格 = 不在任何位平面中。
+    // 每格的抽样只取决于格子编号，只有空格才需要抽样。休眠的区块没有空格、计时也已饱和，
+    // 整块跳过与照常处理的结果相同
+    // 跳跃抽样时每个区块是一条独立的随机数流，以 (回合, 区块, 第几次抽样) 为计数器，
+    // 区块内按行、行内按列的顺序数空格；这样每次长草只抽一次，而不是每个空格一次
+    unsigned int threshold = rng_threshold(spawn_prob);
+    double log_keep = log(1.0 - spawn_prob);
+#pragma omp parallel for schedule(static)
+    for (int b = band_lo; b < band_hi; b++) {
+        int row_end = (b + 1) * BAND_ROWS < grid_h ? (b + 1) * BAND_ROWS : grid_h;
+        for (int k = 0; k < plane_words; k++) {
+            int* quiet = &chunk_quiet[(size_t)b * plane_words + k];
+            if (*quiet >= CHUNK_SLEEP_TICKS) continue;
+            int y0 = k * 64, width = grid_w - y0 < 64 ? grid_w - y0 : 64;
+            unsigned long long mask = width == 64 ? ~0ULL : (1ULL << width) - 1;
+            int full = 1;
+            unsigned long long ctr = (unsigned long long)(unsigned)tick << 32 | (unsigned)(b * plane_words + k) << 12;
+            int draws = 0, spawned = 0;
+            int gap = grass_skip && spawn_prob > 0.0 ? grass_gap(ctr, log_keep) : CHUNK_CELLS;
+            for (int i = b * BAND_ROWS; i < row_end; i++) {
+                unsigned long long* grass = &PLANE_WORD(grass_bits, i, y0);
+                unsigned long long animals = 0;
+                for (int s = 0; s < ANIMAL_SPECIES; s++) animals |= PLANE_WORD(species_bits[s], i, y0);
+                unsigned char* timer = &CELL(grass_timer, i, y0);
+
+                grass_timer_tick(timer, width);
+                unsigned long long free_bits = ~(*grass | animals) & mask;
+                unsigned long long born = 0;
+                if (grass_skip) {
+                    int n = popcount64(free_bits);
+                    while (gap < n) {
+                        // 去掉前 gap 个空格，剩下的最低位就是长草的格子
+                        for (int s = 0; s < gap; s++) free_bits &= free_bits - 1;
+                        int bit = lowest_bit64(free_bits);
+                        free_bits &= free_bits - 1;
+                        n -= gap + 1;
+                        born |= 1ULL << bit;
+                        timer[bit] = 0;
+                        gap = ++draws < CHUNK_CELLS ? grass_gap(ctr | draws, log_keep) : CHUNK_CELLS;
+                    }
+                    gap -= n;
+                }
+                else {
+                    while (free_bits) {
+                        int bit = lowest_bit64(free_bits);
+                        free_bits &= free_bits - 1;
+                        if (cell_random(i * grid_w + y0 + bit, RNG_GRASS) < threshold) {
+                            born |= 1ULL << bit;
+                            timer[bit] = 0;
+                        }
+                    }
+                }
+                *grass |= born;
+                spawned += popcount64(born);
+                if (animals || *grass != mask) full = 0;
+            }
+            // 青草被吃、动物进入时由 settle_grass / mark_band_animals 清零并唤醒
+            *quiet = full ? *quiet + 1 : 0;
+            tile_grass[(size_t)b * plane_words + k] += spawned;
+            bands[b].grass += spawned;
+        }
+    }
+    PROF_END(PROF_GRASS);
+}
+
+int find_nearest_in_original_grid(EntityType me, EntityType target, int x, int y, int* out_x, int* out_y) {
+    int min_dist = grid_w + grid_h;
+    int found = 0;
+    int best_x = -1, best_y = -1;
+    int radius = SPECIES[SPECIES_OF(me)].search_radius;
+    const unsigned long long* plane = species_plane(target);
+    PROF_COUNT(PROF_NEAREST_SCANS);
+
+    for (int dx = -radius; dx <= radius; dx++) {
+        for (int dy = -radius; dy <= radius; dy++) {
+            int nx = x + dx, ny = y + dy;
+            if (!is_valid(nx, ny)) continue;
+            if (PLANE_TEST(plane, nx, ny)) {
+                int dist = abs(dx) + abs(dy);
+                if (dist < min_dist) {
+                    min_dist = dist;
+                    best_x = nx;
+                    best_y = ny;
+                    found = 1;
+                }
+            }
+        }
+    }
+    if (found) {
+        *out_x = best_x;
+        *out_y = best_y;
+        return 1;
+    }
+    return 0;
+}
+
+// 以 target 类型的所有格子为源做曼哈顿距离变换：先逐行求同行最近目标，
+// 再沿列正反各扫一遍合并上下行的候选。只保留距离不超过 cutoff 的结果，只计算本进程模拟的条带
+void build_nearest_field(NearestInfo* field, EntityType target, int cutoff) {
+    const NearestInfo none = NEAREST_PACK(NEAREST_NONE, 0, 0);
+    const unsigned long long* plane = species_plane(target);
+    int row_lo = band_lo * BAND_ROWS;
+    int row_hi = band_hi * BAND_ROWS < grid_h ? band_hi * BAND_ROWS : grid_h;
+
+#pragma omp parallel for schedule(static)
+    for (int i = row_lo; i < row_hi; i++) {
+        NearestInfo* row = &field[(size_t)i * grid_w];
+        int last = -1;
+        for (int j = 0; j < grid_w; j++) {
+            if (PLANE_TEST(plane, i, j)) last = j;
+            row[j] = (last >= 0 && j - last <= cutoff) ? NEAREST_PACK(j - last, 0, last - j) : none;
+        }
+        int next = -1;
+        for (int j = grid_w - 1; j >= 0; j--) {
+            if (PLANE_TEST(plane, i, j)) next = j;
+            if (next >= 0 && next - j <= cutoff && next - j < NEAREST_DIST(row[j]))
+                row[j] = NEAREST_PACK(next - j, 0, next - j);
+        }
+    }
+
+    // 列方向的扫描沿行顺序进行，按列分块并行
+    const int block = 256;
+    int blocks = (grid_w + block - 1) / block;
+#pragma omp parallel for schedule(static)
+    for (int blk = 0; blk < blocks; blk++) {
+        int j0 = blk * block, j1 = j0 + block < grid_w ? j0 + block : grid_w;
+        for (int pass = 0; pass < 2; pass++) {
+            int step = pass == 0 ? 1 : -1;
+            int first = pass == 0 ? row_lo + 1 : row_hi - 2;
+            for (int i = first; i >= row_lo && i < row_hi; i += step) {
+                const NearestInfo* prev = &field[(size_t)(i - step) * grid_w];
+                NearestInfo* row = &field[(size_t)i * grid_w];
+                for (int j = j0; j < j1; j++) {
+                    int dx = NEAREST_DX(prev[j]) - step, dy = NEAREST_DY(prev[j]);
+                    int dist = abs(dx) + abs(dy);
+                    NearestInfo cand = NEAREST_PACK(dist, dx, dy);
+                    if (prev[j] != none && dist <= cutoff && cand < row[j]) row[j] = cand;
+                }
+            }
+        }
+    }
+}
+
+// 与 find_nearest_in_original_grid 结果相同；已建场时查表，否则逐格搜索
+int find_nearest(EntityType me, EntityType target, int x, int y, int* out_x, int* out_y) {
+    if (!nearest_ready[target]) return find_nearest_in_original_grid(me, target, x, y, out_x, out_y);
+
+    PROF_COUNT(PROF_NEAREST_LOOKUPS);
+    int radius = SPECIES[SPECIES_OF(me)].search_radius;
+    NearestInfo n = nearest_field[target][(size_t)x * grid_w + y];
+    int dx = NEAREST_DX(n), dy = NEAREST_DY(n);
+    if (NEAREST_DIST(n) > 2 * radius) return 0; // 方框内的格子曼哈顿距离都不超过 2r
+    if (abs(dx) <= radius && abs(dy) <= radius) {
+        *out_x = x + dx;
+        *out_y = y + dy;
+        return 1;
+    }
+    // 全图最近的目标在方框外，但方框四角可能还有更远的目标
+    return find_nearest_in_original_grid(me, target, x, y, out_x, out_y);
+}
+
+template <int S> static void plan_move(int cell);
+template <int S> static void move_agent(int cell, Band* band);
+template <int S> static void plan_birth(int cell, Band* band);
+template <int S> static void handle_reproduction(int cell, Band* band);
+
+// 各阶段对一个条带中物种 S 的全部个体调用对应的内核，由 ForEachSpecies 按物种展开
+template <int S>
+struct PlanMoves {
+    static void run(Band* band) {
+        for (int k = 0; k < band->animals[S].count; k++) plan_move<S>(band->animals[S].cells[k]);
+    }
+};
+
+template <int S>
+struct MoveAgents {
+    static void run(Band* band) {
+        band->moved[S].count = 0;
+        band->born[S].count = 0;
+        band->breeders[S].count = 0;
+        band->births[S] = band->deaths[S] = 0;
+        for (int k = 0; k < band->animals[S].count; k++) move_agent<S>(band->animals[S].cells[k], band);
+    }
+};
+
+template <int S>
+struct PlanBirths {
+    static void run(Band* band) {
+        for (int k = 0; k < band->animals[S].count; k++) plan_birth<S>(band->animals[S].cells[k], band);
+    }
+};
+
+template <int S>
+struct PlaceOffspring {
+    static void run(Band* band) {
+        for (int k = 0; k < band->breeders[S].count; k++) handle_reproduction<S>(band->breeders[S].cells[k], band);
+    }
+};
+
+// 并行回合：每个阶段只读上一阶段的结果，冲突按“格子编号最小者优先”裁决，
+// 因此任意线程数下结果逐位一致。
+//   1. 各动物根据前缓冲选定移动方向 (plan_move)
+//   2. 裁决移动：rank 小的物种先走；留在原地的猎物被走进来的捕食者吃掉，已经离开的让捕食者扑空 (move_agent)
+//   3. 按新位置把个体重新归入条带
+//   4. 存活个体决定是否繁殖、后代放在哪个空格 (plan_birth)
+//   5. 裁决后代位置并写入后缓冲 (handle_reproduction)
+// 青草只有一份位平面，被吃掉的草在第 3 步统一清除
+void update_entities() {
+    // 后缓冲保存的是上上回合的世界：按它的动物位平面清空动物格子，平面随之清零。
+    // 未分配的区块里不会有动物，整块跳过
+    PROF_BEGIN(PROF_CLEAR);
+    prepare_chunks();
+    int back = grid_front ^ 1;
+#pragma omp parallel for schedule(static)
+    for (int b = band_lo; b < band_hi; b++) {
+        int row_end = (b + 1) * BAND_ROWS < grid_h ? (b + 1) * BAND_ROWS : grid_h;
+        for (int k = 0; k < plane_words; k++) {
+            if (!chunks[(size_t)b * plane_words + k]) continue;
+            for (int i = b * BAND_ROWS; i < row_end; i++) {
+                unsigned long long bits = 0;
+                for (int s = 0; s < ANIMAL_SPECIES; s++) {
+                    unsigned long long* word = &PLANE_WORD(new_species_bits[s], i, k * 64);
+                    bits |= *word;
+                    *word = 0;
+                }
+                while (bits) {
+                    *entity_xy(back, i, k * 64 + lowest_bit64(bits)) = EMPTY;
+                    bits &= bits - 1;
+                }
+            }
+        }
+    }
+    PROF_END(PROF_CLEAR);
+
+    // 动物较密时，逐个搜索的开销 (个数 x 方框面积) 超过整图距离变换，改为预先建场。
+    // 同一种目标的场由吃它的各物种共用，截断距离取其中最大的方框
+    PROF_BEGIN(PROF_FIELDS);
+    long long cells = (long long)grid_w * grid_h;
+    for (int t = GRASS; t < ENTITY_TYPES; t++) {
+        long long work = 0;
+        int cutoff = 0;
+        for (int s = 0; s < ANIMAL_SPECIES; s++) {
+            if (SPECIES[s].food != t) continue;
+            int box = 2 * SPECIES[s].search_radius + 1;
+            work += (long long)species_count[s] * box * box;
+            if (2 * SPECIES[s].search_radius > cutoff) cutoff = 2 * SPECIES[s].search_radius;
+        }
+        nearest_ready[t] = work > cells;
+        if (nearest_ready[t] && !nearest_field[t]) nearest_field[t] = (NearestInfo*)malloc(cells * sizeof(NearestInfo));
+        nearest_ready[t] = nearest_ready[t] && nearest_field[t]; // 内存不足时退回逐格搜索，结果相同
+        if (nearest_ready[t]) build_nearest_field(nearest_field[t], (EntityType)t, cutoff);
+    }
+    PROF_END(PROF_FIELDS);
+
+    PROF_BEGIN(PROF_PLAN_MOVE);
+#pragma omp parallel for schedule(dynamic)
+    for (int b = band_lo; b < band_hi; b++) ForEachSpecies<PlanMoves>::run(&bands[b]);
+    PROF_END(PROF_PLAN_MOVE);
+
+    PROF_BEGIN(PROF_MOVE);
+#pragma omp parallel for schedule(dynamic)
+    for (int b = band_lo; b < band_hi; b++) {
+        bands[b].eaten.count = 0;
+        memset(bands[b].predations, 0, sizeof(bands[b].predations));
+        memset(bands[b].census, 0, sizeof(bands[b].census));
+        ForEachSpecies<MoveAgents>::run(&bands[b]);
+    }
+    PROF_END(PROF_MOVE);
+
+    PROF_BEGIN(PROF_REGROUP);
+#pragma omp parallel for schedule(dynamic)
+    for (int b = band_lo; b < band_hi; b++) {
+        for (int s = 0; s < ANIMAL_SPECIES; s++) bands[b].animals[s].count = 0;
+        regroup_band(b, 0);
+        settle_grass(b);
+    }
+    PROF_END(PROF_REGROUP);
+
+    tick_serial++;
+    PROF_BEGIN(PROF_PLAN_BIRTH);
+#pragma omp parallel for schedule(dynamic)
+    for (int b = band_lo; b < band_hi; b++) ForEachSpecies<PlanBirths>::run(&bands[b]);
+    PROF_END(PROF_PLAN_BIRTH);
+
+    PROF_BEGIN(PROF_BIRTH);
+#pragma omp parallel for schedule(dynamic)
+    for (int b = band_lo; b < band_hi; b++) ForEachSpecies<PlaceOffspring>::run(&bands[b]);
+    PROF_END(PROF_BIRTH);
+
+    PROF_BEGIN(PROF_MARK);
+#pragma omp parallel for schedule(dynamic)
+    for (int b = band_lo; b < band_hi; b++) {
+        regroup_band(b, 1);
+        mark_band_animals(b);
+    }
+    PROF_END(PROF_MARK);
+
+    grass_count = 0;
+    for (int s = 0; s < ANIMAL_SPECIES; s++) {
+        species_count[s] = species_births[s] = species_deaths[s] = species_predations[s] = 0;
+        for (int b = band_lo; b < band_hi; b++) {
+            species_count[s] += bands[b].animals[s].count;
+            species_births[s] += bands[b].births[s];
+            species_deaths[s] += bands[b].deaths[s];
+            species_predations[s] += bands[b].predations[s];
+        }
+    }
+    for (int b = band_lo; b < band_hi; b++) grass_count += bands[b].grass;
+    census_total();
+
+    grid_front = back;
+    for (int s = 0; s < ANIMAL_SPECIES; s++) {
+        unsigned long long* plane = new_species_bits[s];
+        new_species_bits[s] = species_bits[s];
+        species_bits[s] = plane;
+    }
+}
+
+// 把相邻条带 moved（或 born）列表中落在第 b 条带的个体追加到本条带的同物种列表，
+// 列表按物种分开，不必回到区块里查看类型
+void regroup_band(int b, int born) {
+    for (int src = b - 1; src <= b + 1; src++) {
+        if (src < band_lo || src >= band_hi) continue;
+        for (int s = 0; s < ANIMAL_SPECIES; s++) {
+            const AgentList* from = born ? &bands[src].born[s] : &bands[src].moved[s];
+            for (int k = 0; k < from->count; k++) {
+                int cell = from->cells[k];
+                if (BAND_OF(cell) == b) list_push(&bands[b].animals[s], cell);
+            }
+        }
+    }
+}
+
+// 清除相邻条带 eaten 列表中落在第 b 条带的青草，同时从区块与条带的青草数中减去。
+// 同一格可能被登记不止一次，只在青草确实还在时计数
+void settle_grass(int b) {
+    for (int src = b - 1; src <= b + 1; src++) {
+        if (src < band_lo || src >= band_hi) continue;
+        const AgentList* from = &bands[src].eaten;
+        for (int k = 0; k < from->count; k++) {
+            int cell = from->cells[k];
+            if (BAND_OF(cell) != b) continue;
+            int x = cell / grid_w, y = cell % grid_w;
+            if (!PLANE_TEST(grass_bits, x, y)) continue;
+            PLANE_CLEAR(grass_bits, x, y);
+            size_t tile = (size_t)b * plane_words + (y >> CHUNK_SHIFT);
+            chunk_quiet[tile] = 0;
+            tile_grass[tile]--;
+            bands[b].grass--;
+        }
+    }
+}
+
+// 把第 b 条带的存活个体写入下一回合的动物位平面，并统计各区块的动物数
+void mark_band_animals(int b) {
+    for (int s = 0; s < ANIMAL_SPECIES; s++) {
+        for (int k = 0; k < bands[b].animals[s].count; k++) {
+            int cell = bands[b].animals[s].cells[k];
+            PLANE_SET(new_species_bits[s], cell / grid_w, cell % grid_w);
+        }
+    }
+    count_band_tiles(b);
+}
+
+// 回合开始前为有动物的区块及其四周分配内存：本回合的移动、繁殖及其冲突检查
+// 最远只涉及相距 3 格的格子，不会越过相邻区块。四周连续 CHUNK_FREE_TICKS 回合
+// 没有动物的区块随之释放，此时它的两份位平面都已清空。只在串行部分调用
+void prepare_chunks() {
+    for (int r = 0; r < band_count; r++) {
+        for (int c = 0; c < plane_words; c++) {
+            int near = 0;
+            for (int rr = r - 1; rr <= r + 1 && !near; rr++) {
+                for (int cc = c - 1; cc <= c + 1; cc++) {
+                    if (rr < 0 || rr >= band_count || cc < 0 || cc >= plane_words) continue;
+                    if (chunk_animals[(size_t)rr * plane_words + cc]) {
+                        near = 1;
+                        break;
+                    }
+                }
+            }
+            size_t k = (size_t)r * plane_words + c;
+            if (near) {
+                ensure_chunk(k);
+                chunk_idle[k] = 0;
+            }
+            else if (chunks[k] && ++chunk_idle[k] >= CHUNK_FREE_TICKS) {
+                free(chunks[k]);
+                chunks[k] = NULL;
+                chunks_allocated--;
+            }
+        }
+    }
+}
+
+// 当前世界中 (x, y) 处的动物，按位平面判断，不要求区块已分配
+EntityType animal_at(int x, int y) {
+    for (int s = 0; s < ANIMAL_SPECIES; s++) {
+        if (PLANE_TEST(species_bits[s], x, y)) return SPECIES[s].type;
+    }
+    return EMPTY;
+}
+
+// (x, y) 处的动物本回合想去的格子编号；原地不动时返回自身
+static inline int dir_target(int x, int y) {
+    int dir = CELL(move_dir, x, y);
+    return (x + dir_dx[dir]) * grid_w + y + dir_dy[dir];
+}
+
+// (x, y) 处是否有 rank 在 [lo, hi] 之间的动物；物种数是编译期常量，循环会被展开
+template <int lo, int hi>
+static inline int rank_at(int x, int y) {
+    for (int s = 0; s < ANIMAL_SPECIES; s++) {
+        if (SPECIES[s].rank >= lo && SPECIES[s].rank <= hi && PLANE_TEST(species_bits[s], x, y)) return 1;
+    }
+    return 0;
+}
+
+// 是否有编号比 cell 更小、与它 rank 相同且同样想进入 dest 的竞争者。
+// 邻格的类型查位平面，比到各区块里取 Entity 快
+template <int R>
+static int lost_move_conflict(int cell, int dest) {
+    int i = dest / grid_w, j = dest % grid_w;
+    for (int d = 0; d < 9; d++) {
+        int mx = i + dir_dx[d], my = j + dir_dy[d];
+        if (d == STAY_DIR || !is_valid(mx, my)) continue;
+        int m = mx * grid_w + my;
+        if (m < cell && rank_at<R, R>(mx, my) && dir_target(mx, my) == dest) return 1;
+    }
+    return 0;
+}
+
+template <int R> static int move_blocked(int cell, int dest);
+
+// rank 为 R 的动物 (x, y) 本回合能否离开原位
+template <int R>
+static int animal_leaves(int x, int y) {
+    int cell = x * grid_w + y;
+    int dest = dir_target(x, y);
+    return dest != cell && !move_blocked<R>(cell, dest);
+}
+
+// rank 只在运行时知道的动物能否离开：从 R 往下逐级比较，实例化到 rank 0 为止
+template <int R>
+static int earlier_leaves(int rank, int x, int y) {
+    if (R == 0 || rank == R) return animal_leaves<R>(x, y);
+    return earlier_leaves<(R > 0 ? R - 1 : 0)>(rank, x, y);
+}
+
+// rank 为 R 的动物进入 dest 是否受阻。rank 小的先裁决：同 rank 争抢同一格时编号小者获胜；
+// rank 更大的不能进入先走者要去的格子。dest 上原有的动物只可能是移动者的猎物（见 plan_move）：
+// 猎物留下就被吃掉，离开了捕食者就扑空，进入让出的格子，两种情况都不受阻
+template <int R>
+static int move_blocked(int cell, int dest) {
+    if (lost_move_conflict<R>(cell, dest)) return 1;
+    if (R == 0) return 0;
+    int i = dest / grid_w, j = dest % grid_w;
+    for (int d = 0; d < 9; d++) {
+        int mx = i + dir_dx[d], my = j + dir_dy[d];
+        if (d == STAY_DIR || !is_valid(mx, my)) continue;
+        if (rank_at<0, R - 1>(mx, my) && dir_target(mx, my) == dest) return 1;
+    }
+    return 0;
+}
+
+// 留在 cell 的物种 S 的动物是否被吃掉：邻格有吃它的捕食者要走进来且没有受阻
+template <int S>
+static int eaten_in_place(int cell) {
+    int i = cell / grid_w, j = cell % grid_w;
+    for (int d = 0; d < 9; d++) {
+        int mx = i + dir_dx[d], my = j + dir_dy[d];
+        if (d == STAY_DIR || !is_valid(mx, my)) continue;
+        for (int p = 0; p < ANIMAL_SPECIES; p++) {
+            if (SPECIES[p].food == SPECIES[S].type && PLANE_TEST(species_bits[p], mx, my)
+                && dir_target(mx, my) == cell && earlier_leaves<SPECIES_RANKS - 1>(SPECIES[p].rank, mx, my)) return 1;
+        }
+    }
+    return 0;
+}
+
+// 根据前缓冲为 cell 处物种 S 的动物选定移动方向，写入 move_dir
+template <int S>
+static void plan_move(int cell) {
+    int i = cell / grid_w, j = cell % grid_w;
+    int dx = 0, dy = 0;
+    int tx, ty;
+    if (find_nearest(SPECIES[S].type, SPECIES[S].food, i, j, &tx, &ty)) {
+        dx = (tx - i > 0) ? 1 : (tx - i < 0) ? -1 : 0;
+        dy = (ty - j > 0) ? 1 : (ty - j < 0) ? -1 : 0;
+    }
+    else {
+        int dirs[8][2] = { {-1,-1},{-1,0},{-1,1},{0,-1},{0,1},{1,-1},{1,0},{1,1} };
+        int idx = cell_random(cell, RNG_WALK) % 8;
+        dx = dirs[idx][0];
+        dy = dirs[idx][1];
+    }
+
+    // 只能走进空地、草地或自己猎物所在的格子；谁都不能走进其他动物原本所在的格子，
+    // 即使对方本回合会离开（“让出的格子可以进入”要沿一串动物逐个追问，影响范围没有上限，见 README）
+    int dir = STAY_DIR;
+    int nx = i + dx, ny = j + dy;
+    if (is_valid(nx, ny)) {
+        EntityType t = animal_at(nx, ny);
+        if (t == EMPTY || t == SPECIES[S].food)
+            dir = (dx + 1) * 3 + (dy + 1);
+    }
+    if (dir == STAY_DIR) PROF_COUNT(PROF_MOVE_BLOCKED);
+    move_dir[cell] = (unsigned char)dir;
+}
+
+// 裁决 cell 处物种 S 的动物的移动并写入后缓冲（规则见 move_blocked），落败者原地不动。
+// 留在原地被吃掉的猎物不写入，计入死亡；捕食者只在猎物留在目标格时进食
+template <int S>
+static void move_agent(int cell, Band* band) {
+    constexpr int prey = SPECIES[S].food == GRASS ? 0 : SPECIES_OF(SPECIES[S].food);
+    int i = cell / grid_w, j = cell % grid_w;
+    Entity e = *entity_xy(grid_front, i, j);
+    int dest = dir_target(i, j);
+    if (dest != cell && move_blocked<SPECIES[S].rank>(cell, dest)) {
+        PROF_COUNT(PROF_MOVE_LOST);
+        dest = cell;
+    }
+    if (dest == cell && eaten_in_place<S>(cell)) {
+        band->deaths[S]++;
+        return;
+    }
+
+    int move_cost = SPECIES[S].move_cost;
+    if (season == 3) move_cost *= 2;
+
+    int energy_gain = 0;
+    int di = dest / grid_w, dj = dest % grid_w;
+    int on_grass = PLANE_TEST(grass_bits, di, dj);
+    if (SPECIES[S].food == GRASS) {
+        if (on_grass) energy_gain = SPECIES[S].food_energy;
+    }
+    else if (dest != cell && PLANE_TEST(species_bits[prey], di, dj) && !animal_leaves<SPECIES[prey].rank>(di, dj)) {
+        energy_gain = SPECIES[S].food_energy;
+        band->predations[S]++;
+    }
+    if (on_grass) list_push(&band->eaten, dest); // 即使死在刚踏上的格子里，那里的草也已被踩坏
+
+    int energy = ENTITY_ENERGY(e) - move_cost + energy_gain;
+    int age = ENTITY_AGE(e) + 1;
+    if (energy <= 0 || age > ENTITY_MAX_AGE(e)) {
+        band->deaths[S]++;
+        return;
+    }
+    // 从本程序生成的世界出发不会超过上限（见 species.h）；只有外来存档里接近上限的能量才会在这里截断
+    if (energy > ENTITY_ENERGY_MAX) energy = ENTITY_ENERGY_MAX;
+    *entity_xy(grid_front ^ 1, di, dj) = ENTITY_PACK(SPECIES[S].type, energy, age, ENTITY_MAX_AGE(e));
+    census_animal(&band->census[S], energy, age);
+    list_push(&band->moved[S], dest);
+}
+
+// 决定新位置 cell 处物种 S 的存活个体是否繁殖，以及后代想放在哪个空格
+template <int S>
+static void plan_birth(int cell, Band* band) {
+    int i = cell / grid_w, j = cell % grid_w;
+    Chunk* chunk = chunks[CHUNK_INDEX(i, j)];
+    Entity e = chunk->cells[grid_front ^ 1][CHUNK_OFFSET(i, j)];
+    if (ENTITY_ENERGY(e) < species_breed_energy[S] || cell_random(cell, RNG_BREED) >= rng_threshold(species_breed_prob[S])) return;
+
+    for (int attempt = 0; attempt < RNG_BIRTH_ATTEMPTS; attempt++) {
+        unsigned int r = cell_random(cell, RNG_BIRTH + attempt);
+        int dx = (int)(r % 3) - 1;
+        int dy = (int)(r / 3 % 3) - 1;
+        if (dx == 0 && dy == 0) continue;
+        if (is_valid(i + dx, j + dy) && *entity_xy(grid_front ^ 1, i + dx, j + dy) == EMPTY
+            && !PLANE_TEST(grass_bits, i + dx, j + dy)) {
+            chunk->birth_dir[CHUNK_OFFSET(i, j)] = (unsigned char)((dx + 1) * 3 + (dy + 1));
+            chunk->birth_stamp[CHUNK_OFFSET(i, j)] = tick_serial;
+            list_push(&band->breeders[S], cell);
+            return;
+        }
+    }
+    PROF_COUNT(PROF_BIRTH_NO_ROOM);
+}
+
+// 放置 cell 处父代的后代；多个父代（不论物种）选中同一空格时编号最小者获胜
+template <int S>
+static void handle_reproduction(int cell, Band* band) {
+    int pi = cell / grid_w, pj = cell % grid_w;
+    Chunk* chunk = chunks[CHUNK_INDEX(pi, pj)];
+    int off = CHUNK_OFFSET(pi, pj);
+    if (chunk->birth_stamp[off] != tick_serial) return;
+    Entity* parent = &chunk->cells[grid_front ^ 1][off];
+    int child = cell + dir_dx[chunk->birth_dir[off]] * grid_w + dir_dy[chunk->birth_dir[off]];
+
+    int i = child / grid_w, j = child % grid_w;
+    for (int d = 0; d < 9; d++) {
+        int mx = i + dir_dx[d], my = j + dir_dy[d];
+        if (d == STAY_DIR || !is_valid(mx, my)) continue;
+        int m = mx * grid_w + my;
+        if (m >= cell) continue;
+        const Chunk* other = chunks[CHUNK_INDEX(mx, my)];
+        int moff = CHUNK_OFFSET(mx, my);
+        if (other->birth_stamp[moff] == tick_serial
+            && m + dir_dx[other->birth_dir[moff]] * grid_w + dir_dy[other->birth_dir[moff]] == child) {
+            PROF_COUNT(PROF_BIRTH_LOST);
+            return;
+        }
+    }
+
+    Entity p = *parent;
+    int energy = ENTITY_ENERGY(p) - SPECIES[S].offspring_energy;
+    if (energy < 5) energy = 5;
+    *parent = ENTITY_PACK(ENTITY_TYPE(p), energy, ENTITY_AGE(p), ENTITY_MAX_AGE(p));
+    *entity_xy(grid_front ^ 1, i, j) = ENTITY_PACK(SPECIES[S].type, SPECIES[S].offspring_energy, 0, ENTITY_MAX_AGE(p));
+    census_energy(&band->census[S], ENTITY_ENERGY(p), -1);
+    census_energy(&band->census[S], energy, 1);
+    census_animal(&band->census[S], SPECIES[S].offspring_energy, 0);
+    band->births[S]++;
+    list_push(&band->born[S], child);
+}
+
+int is_valid(int x, int y) {
+    return x >= 0 && x < grid_h && y >= 0 && y < grid_w;
+}
+
+// 写入 CHECKPOINT_ALIGN 对齐所需的填充字节
+static int write_padding(FILE* f) {
+    static const char zeros[CHECKPOINT_ALIGN] = { 0 };
+    long pos = ftell(f);
+    if (pos < 0) return 0;
+    size_t pad = (CHECKPOINT_ALIGN - pos % CHECKPOINT_ALIGN) % CHECKPOINT_ALIGN;
+    return fwrite(zeros, 1, pad, f) == pad;
+}
+
+// 把当前世界的完整状态写入 path；成功返回 1
+int save_checkpoint(const char* path) {
+    CheckpointHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, "ECOCKPT", 8);
+    h.version = CHECKPOINT_VERSION;
+    h.byte_order = 0x01020304;
+    h.grid_w = grid_w;
+    h.grid_h = grid_h;
+    h.plane_words = plane_words;
+    h.tick = tick;
+    h.start_season = start_season;
+    h.rand_seed = rand_seed;
+    h.species = ANIMAL_SPECIES;
+    h.init_grass = init_grass;
+    h.grass_skip = grass_skip;
+    h.grass_count = grass_count;
+    for (int s = 0; s < ANIMAL_SPECIES; s++) {
+        h.init_counts[s] = species_init[s];
+        h.breed_probs[s] = species_breed_prob[s];
+        h.breed_energies[s] = species_breed_energy[s];
+        h.counts[s] = species_count[s];
+        h.max_counts[s] = species_max[s];
+        h.min_counts[s] = species_min[s];
+        h.extinct_ticks[s] = species_extinct_tick[s];
+        h.sums[s] = species_sum[s];
+    }
+    h.sum_grass = sum_grass;
+    h.stat_ticks = stat_ticks;
+
+    size_t cells = (size_t)grid_w * grid_h;
+    size_t plane_bytes = (size_t)grid_h * plane_words * sizeof(unsigned long long);
+    long long align = CHECKPOINT_ALIGN;
+    h.grass_offset = ((long long)sizeof(h) + align - 1) / align * align;
+    h.timer_offset = (h.grass_offset + (long long)plane_bytes + align - 1) / align * align;
+    h.history_offset = (h.timer_offset + (long long)cells + align - 1) / align * align;
+    h.animal_offset = (h.history_offset + (long long)sizeof(HistoryStore) + align - 1) / align * align;
+    h.animal_count = 0;
+    for (int s = 0; s < ANIMAL_SPECIES; s++) h.animal_count += species_count[s];
+
+    FILE* f = fopen(path, "wb");
+    if (!f) return 0;
+    int ok = fwrite(&h, sizeof(h), 1, f) == 1
+        && write_padding(f) && fwrite(grass_bits, 1, plane_bytes, f) == plane_bytes
+        && write_padding(f) && fwrite(grass_timer, 1, cells, f) == cells
+        && write_padding(f) && fwrite(&history, sizeof(history), 1, f) == 1
+        && write_padding(f);
+    for (int b = 0; ok && b < band_count; b++) {
+        for (int s = 0; ok && s < ANIMAL_SPECIES; s++) {
+            const AgentList* list = &bands[b].animals[s];
+            for (int k = 0; ok && k < list->count; k++) {
+                Entity e = *entity_at(grid_front, list->cells[k]);
+                AnimalRecord rec = { list->cells[k], (int)ENTITY_TYPE(e), ENTITY_ENERGY(e), ENTITY_AGE(e), ENTITY_MAX_AGE(e) };
+                ok = fwrite(&rec, sizeof(rec), 1, f) == 1;
+            }
+        }
+    }
+    if (fclose(f) != 0) ok = 0;
+    return ok;
+}
+
+// 把文件（存档、录制）只读映射到内存；成功时返回起始地址并写入文件大小
+const unsigned char* map_file(const char* path, size_t* size) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return NULL;
+    LARGE_INTEGER len;
+    HANDLE mapping = NULL;
+    if (GetFileSizeEx(file, &len) && len.QuadPart > 0)
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (!mapping) return NULL;
+    const unsigned char* data = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    *size = (size_t)len.QuadPart;
+    return data;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    struct stat st;
+    void* data = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+        data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return NULL;
+    *size = (size_t)st.st_size;
+    return (const unsigned char*)data;
+#endif
+}
+
+void unmap_file(const unsigned char* data, size_t size) {
+#ifdef _WIN32
+    (void)size;
+    UnmapViewOfFile(data);
+#else
+    munmap((void*)data, size);
+#endif
+}
+
+// 从 path 恢复完整状态：按存档的地图尺寸分配世界并填入数据；成功返回 1
+int load_checkpoint(const char* path) {
+    size_t size = 0;
+    const unsigned char* data = map_file(path, &size);
+    if (!data) {
+        fprintf(stderr, "无法打开存档: %s\n", path);
+        return 0;
+    }
+
+    CheckpointHeader h;
+    const char* error = NULL;
+    if (size < sizeof(h)) error = "文件过短";
+    else {
+        memcpy(&h, data, sizeof(h));
+        size_t cells = (size_t)h.grid_w * h.grid_h;
+        if (memcmp(h.magic, "ECOCKPT", 8) != 0) error = "不是生态系统存档";
+        else if (h.byte_order != 0x01020304) error = "存档来自字节序不同的机器";
+        else if (h.version != CHECKPOINT_VERSION) error = "存档版本不受支持";
+        else if (h.species != ANIMAL_SPECIES) error = "存档的物种数与本程序不同";
+        else if (h.grid_w < 1 || h.grid_w > 65536 || h.grid_h < 1 || h.grid_h > 65536
+            || (long long)h.grid_w * h.grid_h > INT_MAX || h.plane_words != (h.grid_w + 63) / 64
+            || h.animal_count < 0 || (size_t)h.animal_count > cells) error = "文件头已损坏";
+        else if (h.grass_offset < (long long)sizeof(h) || h.timer_offset < h.grass_offset
+            || h.history_offset < h.timer_offset || h.animal_offset < h.history_offset + (long long)sizeof(HistoryStore)
+            || (size_t)h.animal_offset + (size_t)h.animal_count * sizeof(AnimalRecord) > size) error = "文件不完整";
+    }
+    if (!error) {
+        grid_w = h.grid_w;
+        grid_h = h.grid_h;
+        if (!alloc_world()) error = "内存不足，无法分配地图";
+    }
+    if (error) {
+        fprintf(stderr, "无法读取存档 %s: %s\n", path, error);
+        unmap_file(data, size);
+        return 0;
+    }
+
+    clear_world();
+    memcpy(grass_bits, data + h.grass_offset, (size_t)grid_h * plane_words * sizeof(unsigned long long));
+    memcpy(grass_timer, data + h.timer_offset, (size_t)grid_w * grid_h);
+    memcpy(&history, data + h.history_offset, sizeof(history));
+    if (!history_valid(&history) || history.end_tick != h.tick) {
+        fprintf(stderr, "无法读取存档 %s: 种群历史已损坏\n", path);
+        unmap_file(data, size);
+        free_world();
+        return 0;
+    }
+    const AnimalRecord* rec = (const AnimalRecord*)(data + h.animal_offset);
+    for (int k = 0; k < h.animal_count; k++) {
+        int cell = rec[k].cell;
+        EntityType type = (EntityType)rec[k].type;
+        if (cell < 0 || cell >= grid_w * grid_h || type < RABBIT || type >= ENTITY_TYPES
+            || rec[k].energy <= 0 || rec[k].energy > ENTITY_ENERGY_MAX || rec[k].age < 0
+            || rec[k].age > rec[k].max_age || rec[k].max_age > ENTITY_AGE_MAX
+            || animal_at(cell / grid_w, cell % grid_w) != EMPTY) {
+            fprintf(stderr, "无法读取存档 %s: 第 %d 条动物记录已损坏\n", path, k);
+            unmap_file(data, size);
+            free_world();
+            return 0;
+        }
+        int x = cell / grid_w, y = cell % grid_w;
+        ensure_chunk(CHUNK_INDEX(x, y));
+        *entity_xy(grid_front, x, y) = ENTITY_PACK(type, rec[k].energy, rec[k].age, rec[k].max_age);
+        PLANE_CLEAR(grass_bits, x, y);
+        PLANE_SET(species_bits[SPECIES_OF(type)], x, y);
+        list_push(species_list(&bands[x / BAND_ROWS], type), cell);
+        species_count[SPECIES_OF(type)]++;
+    }
+    unmap_file(data, size);
+    for (int b = 0; b < band_count; b++) {
+        for (int s = 0; s < ANIMAL_SPECIES; s++) list_sort(&bands[b].animals[s]);
+        census_band(b);
+        count_band_grass(b);
+    }
+    census_total();
+
+    tick = h.tick;
+    start_season = h.start_season & 3;
+    rand_seed = h.rand_seed;
+    init_grass = h.init_grass;
+    grass_skip = h.grass_skip != 0;
+    grass_count = h.grass_count;
+    for (int s = 0; s < ANIMAL_SPECIES; s++) {
+        species_init[s] = h.init_counts[s];
+        species_breed_prob[s] = h.breed_probs[s];
+        species_breed_energy[s] = h.breed_energies[s];
+        species_max[s] = h.max_counts[s];
+        species_min[s] = h.min_counts[s];
+        species_extinct_tick[s] = h.extinct_ticks[s];
+        species_sum[s] = h.sums[s];
+    }
+    sum_grass = h.sum_grass;
+    stat_ticks = h.stat_ticks;
+    update_season();
+    return 1;
+}
+
+// 一条带的完整状态，多进程模式下交换边界带用：动物数、青草位平面、各区块的休眠计数、青草计时，
+// 之后是各物种的动物记录。大小按满高的条带、每格一只动物计算
+typedef struct {
+    size_t grass, quiet, timer, animals, size;
+} BandStateLayout;
+
+static BandStateLayout band_state_layout() {
+    BandStateLayout l;
+    l.grass = sizeof(long long);
+    l.quiet = l.grass + (size_t)BAND_ROWS * plane_words * sizeof(unsigned long long);
+    l.timer = l.quiet + (size_t)plane_words * sizeof(int);
+    l.animals = (l.timer + (size_t)BAND_ROWS * grid_w + 7) / 8 * 8;
+    l.size = l.animals + (size_t)BAND_ROWS * grid_w * sizeof(AnimalRecord);
+    return l;
+}
+
+size_t band_state_size() {
+    return band_state_layout().size;
+}
+
+// 清空第 b 条带当前世界中的动物：格子、位平面、个体列表和区块计数
+static void drop_band_animals(int b) {
+    int row_end = (b + 1) * BAND_ROWS < grid_h ? (b + 1) * BAND_ROWS : grid_h;
+    for (int s = 0; s < ANIMAL_SPECIES; s++) {
+        AgentList* list = &bands[b].animals[s];
+        for (int k = 0; k < list->count; k++) *entity_at(grid_front, list->cells[k]) = EMPTY;
+        list->count = 0;
+        for (int i = b * BAND_ROWS; i < row_end; i++)
+            memset(&PLANE_WORD(species_bits[s], i, 0), 0, plane_words * sizeof(unsigned long long));
+    }
+    memset(&chunk_animals[(size_t)b * plane_words], 0, plane_words * sizeof(int));
+    for (int s = 0; s < ANIMAL_SPECIES; s++) {
+        memset(&tile_species[s][(size_t)b * plane_words], 0, plane_words * sizeof(int));
+        memset(&bands[b].census[s], 0, sizeof(SpeciesCensus));
+    }
+}
+
+// 把第 b 条带的状态写入 out（至少 band_state_size() 字节），返回实际写入的字节数
+size_t save_band_state(int b, unsigned char* out) {
+    BandStateLayout l = band_state_layout();
+    int row0 = b * BAND_ROWS;
+    int rows = (row0 + BAND_ROWS < grid_h ? row0 + BAND_ROWS : grid_h) - row0;
+    memcpy(out + l.grass, &PLANE_WORD(grass_bits, row0, 0), (size_t)rows * plane_words * sizeof(unsigned long long));
+    memcpy(out + l.quiet, &chunk_quiet[(size_t)b * plane_words], plane_words * sizeof(int));
+    memcpy(out + l.timer, &CELL(grass_timer, row0, 0), (size_t)rows * grid_w);
+    AnimalRecord* rec = (AnimalRecord*)(out + l.animals);
+    long long count = 0;
+    for (int s = 0; s < ANIMAL_SPECIES; s++) {
+        const AgentList* list = &bands[b].animals[s];
+        for (int k = 0; k < list->count; k++) {
+            Entity e = *entity_at(grid_front, list->cells[k]);
+            AnimalRecord r = { list->cells[k], (int)ENTITY_TYPE(e), ENTITY_ENERGY(e), ENTITY_AGE(e), ENTITY_MAX_AGE(e) };
+            rec[count++] = r;
+        }
+    }
+    memcpy(out, &count, sizeof(count));
+    return l.animals + (size_t)count * sizeof(AnimalRecord);
+}
+
+// 用 save_band_state 写出的数据替换第 b 条带当前世界的青草与动物；后缓冲保持不变
+void load_band_state(int b, const unsigned char* in) {
+    BandStateLayout l = band_state_layout();
+    int row0 = b * BAND_ROWS;
+    int rows = (row0 + BAND_ROWS < grid_h ? row0 + BAND_ROWS : grid_h) - row0;
+    drop_band_animals(b);
+    memcpy(&PLANE_WORD(grass_bits, row0, 0), in + l.grass, (size_t)rows * plane_words * sizeof(unsigned long long));
+    memcpy(&chunk_quiet[(size_t)b * plane_words], in + l.quiet, plane_words * sizeof(int));
+    memcpy(&CELL(grass_timer, row0, 0), in + l.timer, (size_t)rows * grid_w);
+    long long count;
+    memcpy(&count, in, sizeof(count));
+    const AnimalRecord* rec = (const AnimalRecord*)(in + l.animals);
+    for (long long k = 0; k < count; k++) {
+        int x = rec[k].cell / grid_w, y = rec[k].cell % grid_w;
+        int s = SPECIES_OF(rec[k].type);
+        ensure_chunk(CHUNK_INDEX(x, y));
+        *entity_xy(grid_front, x, y) = ENTITY_PACK(rec[k].type, rec[k].energy, rec[k].age, rec[k].max_age);
+        PLANE_SET(species_bits[s], x, y);
+        list_push(&bands[b].animals[s], rec[k].cell);
+    }
+    census_band(b);
+    count_band_grass(b);
+}
+
+// 之后的回合只模拟 [lo, hi) 内的条带，范围外的动物全部移除。范围外残留的青草不再更新，
+// 越过范围边缘的个体也不再跟踪，它们只影响紧挨边缘的十几行
+void set_band_range(int lo, int hi) {
+    for (int b = 0; b < band_count; b++) {
+        if (b < lo || b >= hi) drop_band_animals(b);
+    }
+    band_lo = lo;
+    band_hi = hi;
+}
@@ -0,0 +1,238 @@
+﻿// 生态系统模拟核心：地图与个体、回合推进、统计输出和二进制存档。
+// 交互程序 (FileName.cpp)、终端渲染 (render.cpp) 和基准测试 (bench.cpp) 共用
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <atomic>
+#include <thread>
+#include <chrono>
+
+#define DEFAULT_GRID_SIZE 28
+#define MAX_ENTITIES (grid_w * grid_h)
+#define CHECKPOINT_VERSION 5 // 存档格式版本，布局改变时递增
+#define CHECKPOINT_ALIGN 64  // 存档中各数据段的对齐，便于映射后直接按数组访问
+#define STATS_RING_SIZE 65536 // 统计环形缓冲的容量（记录数，2 的幂）
+#define NEAREST_NONE 255       // 最近目标场中“截断距离内没有目标”的距离值
+#define BAND_ROWS 64           // 并行分块的条带高度；与线程数无关，保证任意线程数下结果一致
+#define STAY_DIR 4             // 方向编号 (dx+1)*3+(dy+1)，4 表示原地不动
+#define BAND_OF(cell) ((cell) / grid_w / BAND_ROWS)
+
+// 区块：动物格子和每回合的意图按 64x64 的区块存放，只为动物附近的区域分配内存。
+// 区块与位平面对齐：第 r 行第 c 列的区块就是条带 r 中每行的第 c 个 64 位字
+#define CHUNK_SHIFT 6
+#define CHUNK_SIZE (1 << CHUNK_SHIFT)
+#define CHUNK_CELLS (CHUNK_SIZE * CHUNK_SIZE)
+#define CHUNK_SLEEP_TICKS 256 // 长满青草且没有动物的区块，保持这么多回合后计时全部饱和，进入休眠
+#define CHUNK_FREE_TICKS 64   // 区块及其四周连续这么多回合没有动物后释放
+#define CHUNK_INDEX(x, y) ((size_t)((x) >> CHUNK_SHIFT) * plane_words + ((y) >> CHUNK_SHIFT))
+#define CHUNK_OFFSET(x, y) ((((x) & (CHUNK_SIZE - 1)) << CHUNK_SHIFT) | ((y) & (CHUNK_SIZE - 1)))
+
+// 按行优先访问运行时尺寸的地图：x 为行 (0..grid_h-1)，y 为列 (0..grid_w-1)
+#define CELL(g, x, y) ((g)[(size_t)(x) * grid_w + (y)])
+
+// 位平面：每格 1 位，每行补齐到整数个 64 位字，条带之间不会共用同一个字
+#define PLANE_WORD(p, x, y) ((p)[(size_t)(x) * plane_words + ((y) >> 6)])
+#define PLANE_TEST(p, x, y) ((int)((PLANE_WORD(p, x, y) >> ((y) & 63)) & 1))
+#define PLANE_SET(p, x, y) (PLANE_WORD(p, x, y) |= 1ULL << ((y) & 63))
+#define PLANE_CLEAR(p, x, y) (PLANE_WORD(p, x, y) &= ~(1ULL << ((y) & 63)))
+
+// 动物从 RABBIT 起连续编号，各物种的特性见 species.h
+typedef enum {
+    EMPTY = 0, GRASS, RABBIT, WOLF, FOX
+} EntityType;
+
+#define ANIMAL_SPECIES 3                         // 动物物种数
+#define SPECIES_OF(type) ((int)(type) - RABBIT) // 动物类型 -> 物种编号
+#define ENTITY_TYPES (RABBIT + ANIMAL_SPECIES)   // EntityType 的取值个数
+
+// 动物格子，打包为 32 位：类型 3 位、能量 13 位、年龄与寿命各 8 位，位置即格子编号，不另存坐标。
+// 青草不占 Entity，只记录在 grass_bits 中，因此类型只会是 EMPTY 或某种动物；全 0 即空格。
+// 各字段够用由 species.h 中的编译期检查保证
+typedef unsigned int Entity;
+#define ENTITY_ENERGY_BITS 13
+#define ENTITY_AGE_BITS 8
+#define ENTITY_ENERGY_MAX ((1 << ENTITY_ENERGY_BITS) - 1)
+#define ENTITY_AGE_MAX ((1 << ENTITY_AGE_BITS) - 1)
+#define ENTITY_PACK(type, energy, age, max_age) \
+    ((unsigned)(type) | ((unsigned)(energy) << 3) | ((unsigned)(age) << 16) | ((unsigned)(max_age) << 24))
+#define ENTITY_TYPE(e) ((EntityType)((e) & 7))
+#define ENTITY_ENERGY(e) ((int)(((e) >> 3) & ENTITY_ENERGY_MAX))
+#define ENTITY_AGE(e) ((int)(((e) >> 16) & ENTITY_AGE_MAX))
+#define ENTITY_MAX_AGE(e) ((int)((e) >> 24))
+
+typedef struct {
+    Entity cells[2][CHUNK_CELLS];         // 前/后双缓冲，grid_front 指出哪一份是当前世界
+    unsigned char birth_dir[CHUNK_CELLS]; // 以父代的新位置为下标
+    int birth_stamp[CHUNK_CELLS];         // 等于 tick_serial 时 birth_dir 才有效，省去每回合清空
+} Chunk;
+
+// 活跃个体列表：记录存活的动物所在的格子编号，回合只遍历这些个体
+typedef struct {
+    int* cells;
+    int count;
+    int capacity;
+} AgentList;
+
+// 一个物种的数量与能量、年龄分布；最后一组还收纳更大的值
+#define CENSUS_BINS 16
+#define CENSUS_ENERGY_STEP 8 // 能量分布每组的宽度
+#define CENSUS_AGE_STEP 5    // 年龄分布每组的宽度
+typedef struct {
+    int count;
+    long long energy_sum, age_sum;
+    int energy[CENSUS_BINS], age[CENSUS_BINS];
+} SpeciesCensus;
+
+// 世界按行切成若干条带，每条带维护自己的个体列表，由各线程并行处理。列表都按物种编号分开
+typedef struct {
+    AgentList animals[ANIMAL_SPECIES];   // 当前位于本条带的存活个体
+    AgentList moved[ANIMAL_SPECIES];     // 本回合从本条带出发、移动后存活的个体新位置（可能越过条带边界）
+    AgentList born[ANIMAL_SPECIES];      // 本条带内的父代生下的后代位置
+    AgentList breeders[ANIMAL_SPECIES];  // 本回合选定了后代位置的父代，只有它们需要裁决繁殖
+    AgentList eaten;                     // 本条带出发的动物吃掉或踩坏的青草位置（可能越过条带边界）
+    int grass;                           // 本条带的青草数，随长草与被吃增减
+    SpeciesCensus census[ANIMAL_SPECIES]; // 本条带出发的存活个体与本条带父代的后代，各条带相加才是全局分布
+    int densest_tile, densest_animals;   // 本条带动物最多的区块及其动物数，没有动物时为 -1 与 0
+    int births[ANIMAL_SPECIES], deaths[ANIMAL_SPECIES], predations[ANIMAL_SPECIES]; // 本回合的事件数
+} Band;
+
+// 最近目标场：每回合开始时对整张地图做一次曼哈顿距离变换，
+// 每格记录最近目标的距离和相对偏移，动物移动时 O(1) 查表代替逐格搜索。
+// 打包为 (距离, dx+128, dy+128) 三个字节，整数大小即“更近、行号更小、列号更小”的顺序
+typedef unsigned int NearestInfo;
+#define NEAREST_PACK(dist, dx, dy) (((unsigned)(dist) << 16) | ((unsigned)((dx) + 128) << 8) | (unsigned)((dy) + 128))
+#define NEAREST_DIST(n) ((int)((n) >> 16))
+#define NEAREST_DX(n) ((int)(((n) >> 8) & 0xFF) - 128)
+#define NEAREST_DY(n) ((int)((n) & 0xFF) - 128)
+
+// 二进制存档：文件头之后依次是青草位平面、青草计时、种群历史 (HistoryStore) 和动物记录，各段按 CHECKPOINT_ALIGN 对齐，
+// 可以整体映射到内存后直接复制。RNG 是计数器式的，种子 + 回合数即为其完整状态
+typedef struct {
+    char magic[8];             // "ECOCKPT"
+    unsigned int version;
+    unsigned int byte_order;   // 0x01020304，用于识别不同字节序的机器写出的文件
+    int grid_w, grid_h, plane_words;
+    int tick, start_season;
+    unsigned int rand_seed;
+    int species;               // 物种数 (ANIMAL_SPECIES)，以下各物种的数组都按物种编号排列
+    int init_grass, grass_skip;
+    int init_counts[ANIMAL_SPECIES];
+    double breed_probs[ANIMAL_SPECIES];
+    int breed_energies[ANIMAL_SPECIES];
+    int grass_count, counts[ANIMAL_SPECIES];
+    int max_counts[ANIMAL_SPECIES], min_counts[ANIMAL_SPECIES];
+    int extinct_ticks[ANIMAL_SPECIES];
+    long long sums[ANIMAL_SPECIES], sum_grass;
+    int stat_ticks;
+    long long grass_offset, timer_offset, history_offset, animal_offset; // 各段在文件中的偏移
+    int animal_count;
+} CheckpointHeader;
+
+typedef struct {
+    int cell;
+    int type;
+    int energy;
+    int age;
+    int max_age;
+} AnimalRecord;
+
+// 每回合一条的统计记录，写入 --stats 指定的时间序列文件（二进制格式即此结构体的原样排列）。
+// 各物种的数组按物种编号排列
+typedef struct {
+    int tick;   // 已完成的回合数
+    int season;
+    int grass;
+    int counts[ANIMAL_SPECIES];
+    int births[ANIMAL_SPECIES];
+    int deaths[ANIMAL_SPECIES];     // 饿死或老死
+    int predations[ANIMAL_SPECIES]; // 该物种吃掉的猎物数，吃草的物种恒为 0
+} TickStats;
+
+// 世界：按区块分配的动物格子与位平面（定义及说明见 ecosystem.cpp）
+extern int grid_w, grid_h;
+extern Chunk** chunks;
+extern int chunk_count, chunks_allocated;
+extern int grid_front;
+extern int plane_words;
+extern unsigned long long* grass_bits;
+extern unsigned long long* species_bits[ANIMAL_SPECIES];
+extern unsigned long long* new_species_bits[ANIMAL_SPECIES];
+extern unsigned char* grass_timer;
+extern Band* bands;
+extern int band_count;
+extern int band_lo, band_hi;
+
+// 当前回合的数量、事件与季节；各物种的值都按物种编号 (SPECIES_OF) 存放，名称等特性见 species.h
+extern int species_count[ANIMAL_SPECIES], grass_count;
+extern int species_births[ANIMAL_SPECIES], species_deaths[ANIMAL_SPECIES], species_predations[ANIMAL_SPECIES];
+extern int tick;
+extern int season;
+extern int start_season;
+extern const char* season_names[4];
+
+// 统计引擎：青草数随长草、吃草增减，能量与年龄分布由移动、繁殖的内核在每个事件上累加，
+// 各区块的动物数在回合末写位平面时顺带统计。各条带的结果汇总后即为全局值，界面和导出查询时不需要扫描地图
+extern SpeciesCensus census[ANIMAL_SPECIES];
+extern int* tile_grass;                    // 每个区块 (64x64) 中的青草数与各物种数量
+extern int* tile_species[ANIMAL_SPECIES];
+extern int densest_tile, densest_animals;  // 动物最多的区块（编号同 CHUNK_INDEX）及其动物数
+
+// 整次运行的统计；逐回合的种群历史见 history.h
+extern int species_max[ANIMAL_SPECIES], species_min[ANIMAL_SPECIES];
+extern int species_extinct_tick[ANIMAL_SPECIES];
+extern long long species_sum[ANIMAL_SPECIES], sum_grass;
+extern int stat_ticks;
+
+// 模拟参数
+extern int init_grass;
+extern int species_init[ANIMAL_SPECIES];
+extern double species_breed_prob[ANIMAL_SPECIES];
+extern int species_breed_energy[ANIMAL_SPECIES];
+extern int grass_skip;
+extern unsigned int rand_seed;
+
+void rng_init(unsigned int seed);
+double now_seconds();
+int alloc_world();
+void free_world();
+void record_tick_stats();
+void census_add(SpeciesCensus* to, const SpeciesCensus* from);
+int stats_open(const char* path);
+void stats_push(const TickStats* rec);
+void stats_close();
+void stats_detach();
+void list_push(AgentList* list, int cell);
+void list_free(AgentList* list);
+void list_sort(AgentList* list);
+AgentList* species_list(Band* band, EntityType type);
+const unsigned long long* species_plane(EntityType type);
+void clear_world();
+void initialize_grid();
+void spawn_world();
+int season_at(int t);
+void update_season();
+void update_grass();
+void update_entities();
+int find_nearest_in_original_grid(EntityType me, EntityType target, int x, int y, int* out_x, int* out_y);
+int find_nearest(EntityType me, EntityType target, int x, int y, int* out_x, int* out_y);
+void build_nearest_field(NearestInfo* field, EntityType target, int cutoff);
+void regroup_band(int b, int born);
+void settle_grass(int b);
+void mark_band_animals(int b);
+void prepare_chunks();
+EntityType animal_at(int x, int y);
+int is_valid(int x, int y);
+int save_checkpoint(const char* path);
+int load_checkpoint(const char* path);
+const unsigned char* map_file(const char* path, size_t* size);
+void unmap_file(const unsigned char* data, size_t size);
+size_t band_state_size();
+size_t save_band_state(int b, unsigned char* out);
+void load_band_state(int b, const unsigned char* in);
+void set_band_range(int lo, int hi);
@@ -0,0 +1,126 @@
+﻿#define _CRT_SECURE_NO_WARNINGS
+#include <string.h>
+#include <limits.h>
+#include "history.h"
+
+HistoryStore history;
+
+// 历史曲线的缩放档：窗口为最近多少回合，0 表示整次运行
+const int history_zoom_ticks[HISTORY_ZOOMS] = { HISTORY_CHART_WIDTH, 500, 5000, 50000, 500000, 0 };
+
+// 每列最多合并的组数：选用的一级的组宽至少为每列回合数的 1/HISTORY_SCAN
+#define HISTORY_SCAN 16
+
+void history_bucket_clear(HistoryBucket* b) {
+    for (int s = 0; s < ANIMAL_SPECIES; s++) {
+        b->min[s] = INT_MAX;
+        b->max[s] = 0;
+        b->sum[s] = 0;
+    }
+    b->ticks = 0;
+}
+
+static void bucket_merge(HistoryBucket* into, const HistoryBucket* b) {
+    if (b->ticks == 0) return;
+    for (int s = 0; s < ANIMAL_SPECIES; s++) {
+        if (b->min[s] < into->min[s]) into->min[s] = b->min[s];
+        if (b->max[s] > into->max[s]) into->max[s] = b->max[s];
+        into->sum[s] += b->sum[s];
+    }
+    into->ticks += b->ticks;
+}
+
+// 把一个回合的各物种数量计入 b
+void history_bucket_count(HistoryBucket* b, const int* counts) {
+    for (int s = 0; s < ANIMAL_SPECIES; s++) {
+        if (counts[s] < b->min[s]) b->min[s] = counts[s];
+        if (counts[s] > b->max[s]) b->max[s] = counts[s];
+        b->sum[s] += counts[s];
+    }
+    b->ticks++;
+}
+
+void history_reset(int start_tick) {
+    int span = 1;
+    for (int k = 0; k < HISTORY_LEVELS; k++) {
+        HistoryLevel* level = &history.levels[k];
+        level->head = level->count = 0;
+        level->span = span;
+        level->first_tick = start_tick;
+        history_bucket_clear(&level->partial);
+        span *= 10;
+    }
+    history.start_tick = history.end_tick = start_tick;
+}
+
+// 每回合结束时调用一次。每一级把本回合计入正在累积的组，攒满 span 回合后放入环形缓冲：
+// 较细的几级丢掉最旧的一组；最粗一级两两合并腾出一半空间，刚攒满的组成为新组宽下的前半组
+void history_add(const int* counts) {
+    for (int k = 0; k < HISTORY_LEVELS; k++) {
+        HistoryLevel* level = &history.levels[k];
+        history_bucket_count(&level->partial, counts);
+        if (level->partial.ticks < level->span) continue;
+        if (level->count == HISTORY_BUCKETS) {
+            if (k == HISTORY_LEVELS - 1) {
+                for (int i = 0; i < HISTORY_BUCKETS / 2; i++) {
+                    HistoryBucket merged = level->buckets[(level->head + 2 * i) % HISTORY_BUCKETS];
+                    bucket_merge(&merged, &level->buckets[(level->head + 2 * i + 1) % HISTORY_BUCKETS]);
+                    level->buckets[i] = merged;
+                }
+                level->head = 0;
+                level->count = HISTORY_BUCKETS / 2;
+                level->span *= 2;
+                continue;
+            }
+            level->head = (level->head + 1) % HISTORY_BUCKETS;
+            level->count--;
+            level->first_tick += level->span;
+        }
+        level->buckets[(level->head + level->count) % HISTORY_BUCKETS] = level->partial;
+        level->count++;
+        history_bucket_clear(&level->partial);
+    }
+    history.end_tick++;
+}
+
+// 检查从存档读入的历史是否自洽
+int history_valid(const HistoryStore* store) {
+    if (store->end_tick < store->start_tick) return 0;
+    for (int k = 0; k < HISTORY_LEVELS; k++) {
+        const HistoryLevel* level = &store->levels[k];
+        if (level->head < 0 || level->head >= HISTORY_BUCKETS || level->count < 0 || level->count > HISTORY_BUCKETS
+            || level->span < 1 || level->partial.ticks < 0 || level->partial.ticks >= level->span
+            || level->first_tick < store->start_tick) return 0;
+    }
+    return 1;
+}
+
+// 把 [from, to) 回合画成 columns 列，每列为该列回合范围内的统计；没有记录的回合（开始之前）为空列。
+// 选用能覆盖 from、且组宽不小于每列回合数 1/HISTORY_SCAN 的最细一级，每列合并的组数有上限。
+// 跨两列的组在两列中都计入，平均值因此略有平滑
+void history_chart(int from, int to, int columns, HistoryBucket* out) {
+    long long range = (long long)to - from;
+    const HistoryLevel* level = &history.levels[HISTORY_LEVELS - 1];
+    for (int k = 0; k < HISTORY_LEVELS; k++) {
+        const HistoryLevel* l = &history.levels[k];
+        if ((l->first_tick <= from || l->first_tick == history.start_tick)
+            && (long long)l->span * HISTORY_SCAN * columns >= range) {
+            level = l;
+            break;
+        }
+    }
+    // 最后一组之后还有正在累积的部分组
+    int last = level->count + (level->partial.ticks > 0 ? 1 : 0);
+    for (int c = 0; c < columns; c++) {
+        HistoryBucket* col = &out[c];
+        history_bucket_clear(col);
+        long long a = from + range * c / columns, b = from + range * (c + 1) / columns;
+        if (b <= a) b = a + 1;
+        if (b <= level->first_tick || a >= history.end_tick) continue;
+        long long i0 = a > level->first_tick ? (a - level->first_tick) / level->span : 0;
+        long long i1 = (b - 1 - level->first_tick) / level->span;
+        for (long long i = i0; i <= i1 && i < last; i++) {
+            bucket_merge(col, i < level->count ? &level->buckets[(level->head + i) % HISTORY_BUCKETS] : &level->partial);
+        }
+    }
+}
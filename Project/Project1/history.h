@@ -0,0 +1,43 @@
+﻿// 多分辨率种群历史：最近的回合逐回合保存，更早的回合按 10、100、1000 回合一组保存
+// 各物种的最小/最大/总和，内存固定（三个物种约 230 KB）。最粗一级写满后两两合并、组宽加倍，因此总能覆盖整次运行；
+// 画历史曲线时每列只合并常数个组，与运行了多少回合无关
+#pragma once
+
+#include "ecosystem.h"
+
+#define HISTORY_LEVELS 4          // 组宽依次为 1、10、100、1000 回合
+#define HISTORY_BUCKETS 1024      // 每一级保存的组数（偶数，最粗一级两两合并）
+#define HISTORY_CHART_WIDTH 50    // 历史曲线的列数
+#define HISTORY_ZOOMS 6           // 历史曲线的缩放档数，见 history_zoom_ticks
+
+// 一组连续回合中各物种数量的统计，按物种编号排列；ticks 为 0 表示空组
+typedef struct {
+    int min[ANIMAL_SPECIES], max[ANIMAL_SPECIES];
+    long long sum[ANIMAL_SPECIES];
+    int ticks;
+} HistoryBucket;
+
+typedef struct {
+    HistoryBucket buckets[HISTORY_BUCKETS]; // 环形缓冲，head 为最旧的一组
+    HistoryBucket partial;                  // 正在累积、还不满 span 回合的一组
+    int head, count;
+    int span;       // 每组的回合数
+    int first_tick; // 最旧一组的起始回合
+} HistoryLevel;
+
+// 整块按原样写入存档，不含指针
+typedef struct {
+    HistoryLevel levels[HISTORY_LEVELS];
+    int start_tick; // 开始记录的回合
+    int end_tick;   // 已记录到的回合（不含）
+} HistoryStore;
+
+extern HistoryStore history;
+extern const int history_zoom_ticks[HISTORY_ZOOMS];
+
+void history_reset(int start_tick);
+void history_add(const int* counts);
+void history_bucket_clear(HistoryBucket* b);
+void history_bucket_count(HistoryBucket* b, const int* counts);
+int history_valid(const HistoryStore* store);
+void history_chart(int from, int to, int columns, HistoryBucket* out);
@@ -0,0 +1,100 @@
+﻿#define _CRT_SECURE_NO_WARNINGS
+#include "ecosystem.h"
+#include "profile.h"
+
+#ifdef ECO_PROFILE
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#define PROF_MAX_THREADS 256
+
+const char* prof_phase_names[PROF_PHASES] = {
+    "update_grass", "clear_back_buffer", "nearest_fields", "plan_move", "move",
+    "regroup_moved", "plan_birth", "reproduction", "regroup_born", "publish_view", "render"
+};
+const char* prof_counter_names[PROF_COUNTERS] = {
+    "nearest_scans", "nearest_lookups", "move_blocked", "move_lost",
+    "birth_no_room", "birth_lost", "rng_draws"
+};
+
+// 阶段计时由模拟线程（渲染阶段由渲染线程）在并行区之外累加，每阶段每回合一次。
+// 事件计数在并行循环内部发生，每个线程写自己的一行，行之间按缓存行对齐，读取时求和
+std::atomic<long long> prof_ns[PROF_PHASES];
+std::atomic<long long> prof_calls[PROF_PHASES];
+
+struct alignas(64) ProfSlot {
+    std::atomic<long long> counts[PROF_COUNTERS];
+};
+ProfSlot prof_slots[PROF_MAX_THREADS];
+
+void prof_add_time(int phase, double seconds) {
+    prof_ns[phase].fetch_add((long long)(seconds * 1e9), std::memory_order_relaxed);
+    prof_calls[phase].fetch_add(1, std::memory_order_relaxed);
+}
+
+void prof_count(int counter) {
+#ifdef _OPENMP
+    int t = omp_get_thread_num() % PROF_MAX_THREADS;
+#else
+    int t = 0;
+#endif
+    // 每行只有一个线程写，不需要原子的读-改-写
+    std::atomic<long long>& c = prof_slots[t].counts[counter];
+    c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+void prof_reset() {
+    for (int p = 0; p < PROF_PHASES; p++) {
+        prof_ns[p].store(0);
+        prof_calls[p].store(0);
+    }
+    for (int t = 0; t < PROF_MAX_THREADS; t++) {
+        for (int c = 0; c < PROF_COUNTERS; c++) prof_slots[t].counts[c].store(0);
+    }
+}
+
+// 已统计的回合数，即 update_grass 的调用次数
+int prof_ticks() {
+    return (int)prof_calls[PROF_GRASS].load(std::memory_order_relaxed);
+}
+
+double prof_phase_seconds(int phase) {
+    return prof_ns[phase].load(std::memory_order_relaxed) * 1e-9;
+}
+
+long long prof_phase_calls(int phase) {
+    return prof_calls[phase].load(std::memory_order_relaxed);
+}
+
+long long prof_counter(int counter) {
+    long long sum = 0;
+    for (int t = 0; t < PROF_MAX_THREADS; t++) sum += prof_slots[t].counts[counter].load(std::memory_order_relaxed);
+    return sum;
+}
+
+// 写出 JSON：每阶段的调用次数、总时间和平均时间，每种事件的总数和每回合的平均数
+int prof_write_json(const char* path) {
+    FILE* f = fopen(path, "w");
+    if (!f) return 0;
+    int ticks = prof_ticks();
+    fprintf(f, "{\n  \"grid_w\": %d, \"grid_h\": %d, \"ticks\": %d,\n  \"phases\": [\n", grid_w, grid_h, ticks);
+    for (int p = 0; p < PROF_PHASES; p++) {
+        long long calls = prof_phase_calls(p);
+        double total = prof_phase_seconds(p);
+        fprintf(f, "    {\"name\": \"%s\", \"calls\": %lld, \"total_ms\": %.3f, \"mean_us\": %.3f}%s\n",
+            prof_phase_names[p], calls, total * 1e3, calls ? total * 1e6 / calls : 0.0,
+            p + 1 < PROF_PHASES ? "," : "");
+    }
+    fprintf(f, "  ],\n  \"counters\": [\n");
+    for (int c = 0; c < PROF_COUNTERS; c++) {
+        long long n = prof_counter(c);
+        fprintf(f, "    {\"name\": \"%s\", \"total\": %lld, \"per_tick\": %.3f}%s\n",
+            prof_counter_names[c], n, ticks ? (double)n / ticks : 0.0, c + 1 < PROF_COUNTERS ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+    return fclose(f) == 0;
+}
+
+#endif
@@ -0,0 +1,56 @@
+﻿// 性能统计：各阶段的计时和关键事件的计数。只有定义 ECO_PROFILE 时才编译进来，
+// 否则下面的宏全部展开为空，不产生任何开销
+#pragma once
+
+// 计时的阶段：update_grass、update_entities 的各趟、画面发布与渲染
+enum {
+    PROF_GRASS = 0,     // update_grass
+    PROF_CLEAR,         // 清空后缓冲
+    PROF_FIELDS,        // 建最近目标场
+    PROF_PLAN_MOVE,     // 选定移动方向
+    PROF_MOVE,          // 裁决移动、进食与死亡
+    PROF_REGROUP,       // 按新位置归入条带并结算青草
+    PROF_PLAN_BIRTH,    // 选定后代位置
+    PROF_BIRTH,         // 放置后代 (handle_reproduction_in_new_grid)
+    PROF_MARK,          // 后代归入条带并写位平面
+    PROF_PUBLISH,       // 复制画面 (publish_view)
+    PROF_RENDER,        // 组装并输出一帧
+    PROF_PHASES
+};
+
+// 计数的事件
+enum {
+    PROF_NEAREST_SCANS = 0, // 逐格的方框搜索 (find_nearest_in_original_grid)
+    PROF_NEAREST_LOOKUPS,   // 最近目标场的查表
+    PROF_MOVE_BLOCKED,      // 想去的格子在地图外或已被其他动物占据，原地不动
+    PROF_MOVE_LOST,         // 争抢同一格时落败，或狼要进入的格子被兔子占去
+    PROF_BIRTH_NO_ROOM,     // 满足繁殖条件但周围没有空格
+    PROF_BIRTH_LOST,        // 多个父代选中同一空格时落败
+    PROF_RNG_DRAWS,         // 随机数抽样次数
+    PROF_COUNTERS
+};
+
+#ifdef ECO_PROFILE
+
+#define PROF_BEGIN(phase) double prof_start_##phase = now_seconds()
+#define PROF_END(phase) prof_add_time(phase, now_seconds() - prof_start_##phase)
+#define PROF_COUNT(counter) prof_count(counter)
+
+void prof_add_time(int phase, double seconds);
+void prof_count(int counter);
+void prof_reset();
+int prof_ticks();
+double prof_phase_seconds(int phase);
+long long prof_phase_calls(int phase);
+long long prof_counter(int counter);
+int prof_write_json(const char* path);
+extern const char* prof_phase_names[PROF_PHASES];
+extern const char* prof_counter_names[PROF_COUNTERS];
+
+#else
+
+#define PROF_BEGIN(phase) ((void)0)
+#define PROF_END(phase) ((void)0)
+#define PROF_COUNT(counter) ((void)0)
+
+#endif
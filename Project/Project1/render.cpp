@@ -0,0 +1,455 @@
+﻿#define _CRT_SECURE_NO_WARNINGS
+#include "render.h"
+#include "profile.h"
+#include "species.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+std::atomic<int> paused(0);
+std::atomic<int> delay_ms(250);
+
+char message[128] = { 0 };
+int message_timeout = 0;
+
+DisplayView view = {};
+std::mutex view_mutex;
+std::atomic<int> view_wanted(1);
+std::atomic<int> show_profile(0);
+std::atomic<int> show_census(0);
+std::atomic<int> history_zoom(0);
+
+// 终端渲染：每帧先拼进一块复用的缓冲区，再一次 write 输出。地图逐格与上一帧比较，
+// 只重绘变化的格子、只在颜色改变时输出颜色转义；地图下方的文字按行比较，只重写变化的行
+char* frame_buf = NULL;
+size_t frame_len = 0, frame_cap = 0;
+unsigned char* frame_cells = NULL; // 上一帧每格显示的符号编号，0xFF 表示需要重绘
+int frame_cells_size = 0;
+char frame_text[MAX_TEXT_LINES][TEXT_LINE_SIZE];      // 本帧正在组装的文字行
+char frame_prev_text[MAX_TEXT_LINES][TEXT_LINE_SIZE]; // 上一帧输出的文字行
+int frame_text_count = 0, frame_prev_text_count = 0;
+int frame_full_redraw = 1;
+int cursor_row = 0, cursor_col = 0; // 终端光标位置（从 1 开始），0 表示未知
+int cursor_color = -1;              // 当前终端颜色，-1 表示未知
+
+void draw_map();
+void draw_status();
+void draw_profile();
+void draw_census();
+void draw_history_chart();
+void draw_legend();
+void draw_controls();
+
+// 把当前世界复制为渲染线程使用的画面
+void publish_view() {
+    std::lock_guard<std::mutex> lock(view_mutex);
+    PROF_BEGIN(PROF_PUBLISH);
+    int cells = grid_w * grid_h;
+    if (!view.glyphs || view.cells != cells) {
+        free(view.glyphs);
+        view.glyphs = (unsigned char*)malloc(cells);
+        if (!view.glyphs) {
+            fprintf(stderr, "内存不足：无法分配画面缓冲区\n");
+            exit(1);
+        }
+        view.cells = cells;
+    }
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < grid_h; i++) {
+        for (int j = 0; j < grid_w; j++) view.glyphs[(size_t)i * grid_w + j] = (unsigned char)map_glyph(i, j);
+    }
+    view.tick = tick;
+    view.season = season;
+    view.grass = grass_count;
+    for (int s = 0; s < ANIMAL_SPECIES; s++) {
+        view.counts[s] = species_count[s];
+        view.max_counts[s] = species_max[s];
+        view.min_counts[s] = species_min[s] == INT_MAX ? 0 : species_min[s];
+    }
+    view.seed = rand_seed;
+    view.has_census = 1;
+    memcpy(view.census, census, sizeof(census));
+    view.densest_row = densest_tile < 0 ? -1 : densest_tile / plane_words;
+    view.densest_col = densest_tile < 0 ? -1 : densest_tile % plane_words;
+    view.densest_animals = densest_animals;
+    view.densest_grass = densest_tile < 0 ? 0 : tile_grass[densest_tile];
+    int window = history_zoom_ticks[history_zoom.load()];
+    view.chart_to = history.end_tick;
+    view.chart_from = window > 0 ? view.chart_to - window : history.start_tick;
+    history_chart(view.chart_from, view.chart_to, HISTORY_CHART_WIDTH, view.chart);
+    view.serial++;
+    view_wanted.store(0);
+    PROF_END(PROF_PUBLISH);
+}
+
+// 可由模拟线程和输入线程调用
+void set_message(const char* msg) {
+    std::lock_guard<std::mutex> lock(view_mutex);
+    strncpy(message, msg, sizeof(message) - 1);
+    message[sizeof(message) - 1] = '\0';
+    message_timeout = 3 * RENDER_FPS;
+}
+
+// 地图格子的显示符号：0 空地、1 嫩草、2 熟草，之后按物种编号依次排列，字符与颜色取自物种特性表
+static const char ground_glyphs[3] = { '.', 'g', 'G' };
+static const int ground_colors[3] = { 0, 32, 32 }; // 0 为默认色
+
+int map_glyph(int i, int j) {
+    if (PLANE_TEST(grass_bits, i, j)) return CELL(grass_timer, i, j) < 4 ? 1 : 2;
+    EntityType type = animal_at(i, j);
+    return type == EMPTY ? 0 : 3 + SPECIES_OF(type);
+}
+
+// 保证缓冲区还能再放 n 字节；按需扩大，大地图整屏重绘时不必按最坏情况一次分配
+static void frame_reserve(size_t n) {
+    if (frame_len + n <= frame_cap) return;
+    size_t cap = frame_cap ? frame_cap : 4096;
+    while (cap < frame_len + n) cap *= 2;
+    char* buf = (char*)realloc(frame_buf, cap);
+    if (!buf) {
+        fprintf(stderr, "内存不足：无法分配渲染缓冲区\n");
+        exit(1);
+    }
+    frame_buf = buf;
+    frame_cap = cap;
+}
+
+static void frame_put(const char* s, size_t n) {
+    memcpy(frame_buf + frame_len, s, n);
+    frame_len += n;
+}
+
+static void frame_puts(const char* s) {
+    frame_put(s, strlen(s));
+}
+
+static void frame_move(int row, int col) {
+    if (row == cursor_row && col == cursor_col) return;
+    frame_len += sprintf(frame_buf + frame_len, "\033[%d;%dH", row, col);
+    cursor_row = row;
+    cursor_col = col;
+}
+
+static void frame_color(int color) {
+    if (color == cursor_color) return;
+    frame_len += sprintf(frame_buf + frame_len, "\033[%dm", color);
+    cursor_color = color;
+}
+
+// 向本帧的文字区追加一行
+static void frame_line(const char* fmt, ...) {
+    if (frame_text_count == MAX_TEXT_LINES) return;
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(frame_text[frame_text_count++], TEXT_LINE_SIZE, fmt, args);
+    va_end(args);
+}
+
+// 把整块缓冲区交给终端，尽量一次系统调用写完
+static void write_frame(const char* data, size_t len) {
+    fflush(stdout);
+#ifdef _WIN32
+    DWORD written;
+    WriteFile(GetStdHandle(STD_OUTPUT_HANDLE), data, (DWORD)len, &written, NULL);
+#else
+    while (len > 0) {
+        ssize_t n = write(STDOUT_FILENO, data, len);
+        if (n <= 0) break;
+        data += n;
+        len -= (size_t)n;
+    }
+#endif
+}
+
+// 下一帧整屏重绘（首帧，或其他输出覆盖了屏幕之后）
+void render_invalidate() {
+    frame_full_redraw = 1;
+}
+
+// 释放渲染缓冲区，不向终端输出
+void render_release() {
+    free(frame_buf);
+    free(frame_cells);
+    frame_buf = NULL;
+    frame_cells = NULL;
+    frame_cap = 0;
+    frame_cells_size = 0;
+}
+
+void render_free() {
+    if (frame_buf) {
+        const char* restore = "\033[0m\033[?25h"; // 恢复颜色并显示光标
+        write_frame(restore, strlen(restore));
+    }
+    render_release();
+}
+
+// 组装一帧但不输出：地图 + 状态 + 历史曲线 + 图例 + 操作说明 + 提示信息，返回本帧的字节数。
+// 只读 view 和提示信息，调用者须持有 view_mutex
+size_t render_compose() {
+    int cells = grid_w * grid_h;
+    if (frame_cells_size != cells) {
+        render_release();
+        frame_cells = (unsigned char*)malloc(cells);
+        if (!frame_cells) {
+            fprintf(stderr, "内存不足：无法分配渲染缓冲区\n");
+            exit(1);
+        }
+        frame_cells_size = cells;
+        frame_full_redraw = 1;
+#ifdef _WIN32
+#ifndef ENABLE_VIRTUAL_TERMINAL_PROCESSING
+#define ENABLE_VIRTUAL_TERMINAL_PROCESSING 0x0004
+#endif
+        HANDLE out = GetStdHandle(STD_OUTPUT_HANDLE);
+        DWORD mode;
+        if (GetConsoleMode(out, &mode)) SetConsoleMode(out, mode | ENABLE_VIRTUAL_TERMINAL_PROCESSING);
+#endif
+    }
+
+    frame_len = 0;
+    frame_reserve(64);
+    if (frame_full_redraw) {
+        frame_puts("\033[0m\033[?25l\033[2J"); // 复位颜色、隐藏光标、清屏
+        memset(frame_cells, 0xFF, cells);
+        frame_prev_text_count = 0;
+        cursor_row = cursor_col = 0;
+        cursor_color = 0;
+        frame_full_redraw = 0;
+    }
+
+    draw_map();
+
+    frame_text_count = 0;
+    draw_status();
+    if (show_profile.load()) draw_profile();
+    if (show_census.load()) draw_census();
+    draw_history_chart();
+    draw_legend();
+    draw_controls();
+    if (message_timeout > 0) {
+        frame_line("");
+        frame_line(">>> %s", message);
+        message_timeout--;
+    }
+
+    // 文字区紧接在地图下方，逐行比较；变短的行和多出的旧行用“清除到行尾”抹掉
+    int lines = frame_text_count > frame_prev_text_count ? frame_text_count : frame_prev_text_count;
+    for (int k = 0; k < lines; k++) {
+        const char* text = k < frame_text_count ? frame_text[k] : "";
+        if (k < frame_prev_text_count && strcmp(text, frame_prev_text[k]) == 0) continue;
+        frame_reserve(TEXT_LINE_SIZE + 64);
+        frame_move(grid_h + 1 + k, 1);
+        frame_color(0);
+        frame_puts(text);
+        frame_puts("\033[K");
+        cursor_row = cursor_col = 0; // 含中文的行显示宽度不定，之后重新定位
+        cursor_color = -1;
+        if (k < frame_text_count) strcpy(frame_prev_text[k], text);
+    }
+    frame_prev_text_count = frame_text_count;
+    frame_reserve(64);
+    frame_move(grid_h + 1 + frame_text_count, 1);
+    frame_color(0);
+    return frame_len;
+}
+
+// 组装一帧并一次写给终端
+void render_frame() {
+    PROF_BEGIN(PROF_RENDER);
+    render_compose();
+    write_frame(frame_buf, frame_len);
+    PROF_END(PROF_RENDER);
+}
+
+void draw_map() {
+    for (int i = 0; i < grid_h; i++) {
+        frame_reserve((size_t)grid_w * 24); // 最坏情况下每格都需要定位和换色
+        unsigned char* prev = &frame_cells[(size_t)i * grid_w];
+        for (int j = 0; j < grid_w; j++) {
+            int g = view.glyphs[(size_t)i * grid_w + j];
+            if (prev[j] == g) continue;
+            prev[j] = (unsigned char)g;
+            frame_move(i + 1, j + 1);
+            frame_color(g < 3 ? ground_colors[g] : SPECIES[g - 3].color);
+            frame_buf[frame_len++] = g < 3 ? ground_glyphs[g] : SPECIES[g - 3].glyph;
+            cursor_col++;
+        }
+    }
+}
+
+void draw_status() {
+    // 实际模拟速度：每秒根据画面中的回合数更新一次
+    static int rate_tick = 0;
+    static double rate_time = 0, rate = 0;
+    double now = now_seconds();
+    if (now - rate_time >= 1.0) {
+        rate = rate_time > 0 && view.tick >= rate_tick ? (view.tick - rate_tick) / (now - rate_time) : 0;
+        rate_tick = view.tick;
+        rate_time = now;
+    }
+
+    frame_line("");
+    frame_line("【当前状态】 回合: %4d | 季节: %s", view.tick, season_names[view.season]);
+    char counts[TEXT_LINE_SIZE], extrema[TEXT_LINE_SIZE];
+    int len = snprintf(counts, sizeof(counts), "青草: %3d", view.grass);
+    int ext = snprintf(extrema, sizeof(extrema), "历史峰值/谷值:");
+    for (int s = 0; s < ANIMAL_SPECIES; s++) {
+        len += snprintf(counts + len, sizeof(counts) - len, " | %s: %3d", SPECIES[s].name, view.counts[s]);
+        ext += snprintf(extrema + ext, sizeof(extrema) - ext, "%s %s %3d/%3d", s ? " |" : "",
+            SPECIES[s].name, view.max_counts[s], view.min_counts[s]);
+    }
+    frame_line("%s", counts);
+    frame_line("%s", extrema);
+    if (view.replay_status[0]) {
+        frame_line("%s", view.replay_status);
+        return;
+    }
+
+    int delay = delay_ms.load();
+    char speed[32];
+    if (delay > 0) sprintf(speed, "%d 毫秒/回合", delay);
+    else strcpy(speed, "全速");
+    frame_line("模拟速度: %s（实际 %.0f 回合/秒）| 状态: %s | 随机种子: %u",
+        speed, rate, paused.load() ? "【已暂停】" : "运行中", view.seed);
+}
+
+// 性能统计面板（P 键开关）：模拟各阶段每回合的平均用时与占比，画面发布和渲染每次的用时，
+// 以及每回合的平均事件数
+void draw_profile() {
+    frame_line("");
+#ifdef ECO_PROFILE
+    int ticks = prof_ticks();
+    double sim_total = 0;
+    for (int p = PROF_GRASS; p <= PROF_MARK; p++) sim_total += prof_phase_seconds(p);
+    frame_line("【性能统计】已统计 %d 回合，每回合平均 %.1f 微秒:", ticks, ticks ? sim_total * 1e6 / ticks : 0.0);
+    char line[TEXT_LINE_SIZE];
+    int len = 0;
+    for (int p = PROF_GRASS; p <= PROF_MARK; p++) {
+        double sec = prof_phase_seconds(p);
+        len += snprintf(line + len, sizeof(line) - len, "  %-17s %9.1f (%2.0f%%)", prof_phase_names[p],
+            ticks ? sec * 1e6 / ticks : 0.0, sim_total > 0 ? sec * 100 / sim_total : 0.0);
+        if ((p - PROF_GRASS) % 2 == 1 || p == PROF_MARK) {
+            frame_line("%s", line);
+            len = 0;
+        }
+    }
+    for (int p = PROF_PUBLISH; p <= PROF_RENDER; p++) {
+        long long calls = prof_phase_calls(p);
+        len += snprintf(line + len, sizeof(line) - len, "  %-17s %9.1f 微秒/次",
+            prof_phase_names[p], calls ? prof_phase_seconds(p) * 1e6 / calls : 0.0);
+    }
+    frame_line("%s", line);
+    len = 0;
+    for (int c = 0; c < PROF_COUNTERS; c++) {
+        len += snprintf(line + len, sizeof(line) - len, "%s%s %.1f", c == 0 ? "每回合事件: " : len == 0 ? "  " : " | ",
+            prof_counter_names[c], ticks ? (double)prof_counter(c) / ticks : 0.0);
+        if (c == 3 || c == PROF_COUNTERS - 1) {
+            frame_line("%s", line);
+            len = 0;
+        }
+    }
+#else
+    frame_line("【性能统计】未编译进本程序（编译时定义 ECO_PROFILE，CMake 中为 -DECO_PROFILE=ON）");
+#endif
+}
+
+// 把一组分布画成 CENSUS_BINS 个字符（按最大的一格缩放，空格为 0，. 到 @ 依次增多）
+void census_bars(const int* bins, char* out) {
+    static const char ramp[] = " .:-=+*#%@";
+    int max = 0;
+    for (int k = 0; k < CENSUS_BINS; k++) {
+        if (bins[k] > max) max = bins[k];
+    }
+    for (int k = 0; k < CENSUS_BINS; k++) out[k] = bins[k] == 0 ? ' ' : ramp[1 + (long long)bins[k] * 8 / max];
+    out[CENSUS_BINS] = '\0';
+}
+
+// 分布面板（D 键开关）：动物最多的区块，以及各物种的平均能量、平均年龄和分布
+void draw_census() {
+    if (!view.has_census) return;
+    frame_line("");
+    if (view.densest_row < 0) frame_line("【分布】地图上没有动物");
+    else frame_line("【分布】动物最多的区块 (%dx%d): 第 %d 行第 %d 列 | 动物 %d 只 | 青草 %d",
+        CHUNK_SIZE, CHUNK_SIZE, view.densest_row, view.densest_col, view.densest_animals, view.densest_grass);
+    for (int s = 0; s < ANIMAL_SPECIES; s++) {
+        const SpeciesCensus* c = &view.census[s];
+        if (c->count == 0) continue;
+        char energy[CENSUS_BINS + 1], age[CENSUS_BINS + 1];
+        census_bars(c->energy, energy);
+        census_bars(c->age, age);
+        frame_line("  %s %5d 只 | 能量 平均 %5.1f [%s] | 年龄 平均 %4.1f [%s]", SPECIES[s].name, c->count,
+            (double)c->energy_sum / c->count, energy, (double)c->age_sum / c->count, age);
+    }
+    frame_line("  （能量每格 %d，年龄每格 %d，最后一格含更大的值）", CENSUS_ENERGY_STEP, CENSUS_AGE_STEP);
+}
+
+// 每列画该列回合范围内的平均数量；标题行给出窗口内的最小/最大值
+void draw_history_chart() {
+    const HistoryBucket* chart = view.chart;
+    long long max_val = 1;
+    HistoryBucket window;
+    history_bucket_clear(&window);
+    for (int i = 0; i < HISTORY_CHART_WIDTH; i++) {
+        const HistoryBucket* b = &chart[i];
+        if (b->ticks == 0) continue;
+        for (int s = 0; s < ANIMAL_SPECIES; s++) {
+            if (b->sum[s] / b->ticks > max_val) max_val = b->sum[s] / b->ticks;
+            if (b->min[s] < window.min[s]) window.min[s] = b->min[s];
+            if (b->max[s] > window.max[s]) window.max[s] = b->max[s];
+        }
+    }
+
+    int height = 6;
+    int range = view.chart_to - view.chart_from;
+    char row[HISTORY_CHART_WIDTH + 1];
+    frame_line("");
+    if (history_zoom_ticks[history_zoom.load()] == 0) frame_line("【种群历史】全程 %d 回合，每列约 %d 回合的平均  [ ]=缩放", range, (range + HISTORY_CHART_WIDTH - 1) / HISTORY_CHART_WIDTH);
+    else if (range <= HISTORY_CHART_WIDTH) frame_line("【种群历史】最近 %d 回合数量变化  [ ]=缩放", range);
+    else frame_line("【种群历史】最近 %d 回合，每列 %d 回合的平均  [ ]=缩放", range, range / HISTORY_CHART_WIDTH);
+    char line[TEXT_LINE_SIZE];
+    int len = snprintf(line, sizeof(line), "  区间内");
+    for (int s = 0; s < ANIMAL_SPECIES; s++) {
+        len += snprintf(line + len, sizeof(line) - len, "%s %s: %d~%d", s ? " |" : "", SPECIES[s].name,
+            window.min[s] == INT_MAX ? 0 : window.min[s], window.max[s]);
+    }
+    frame_line("%s", line);
+    // 各物种用地图上的字符，编号大的画在上层
+    for (int h = height - 1; h >= 0; h--) {
+        for (int i = 0; i < HISTORY_CHART_WIDTH; i++) {
+            const HistoryBucket* b = &chart[i];
+            char c = ' ';
+            for (int s = 0; s < ANIMAL_SPECIES; s++) {
+                if (b->ticks > 0 && b->sum[s] / b->ticks * height / max_val > h) c = SPECIES[s].glyph;
+            }
+            row[i] = c;
+        }
+        row[HISTORY_CHART_WIDTH] = '\0';
+        frame_line("| %s", row);
+    }
+    memset(row, '-', HISTORY_CHART_WIDTH);
+    frame_line("+%s", row);
+}
+
+void draw_legend() {
+    frame_line("");
+    char line[TEXT_LINE_SIZE];
+    int len = snprintf(line, sizeof(line), "【图例】 \033[32mg\033[0m=嫩草 \033[32mG\033[0m=熟草 ");
+    for (int s = 0; s < ANIMAL_SPECIES; s++) {
+        len += snprintf(line + len, sizeof(line) - len, "\033[%dm%c\033[0m=%s ",
+            SPECIES[s].color, SPECIES[s].glyph, SPECIES[s].name);
+    }
+    frame_line("%s.=空地", line);
+}
+
+void draw_controls() {
+    frame_line("");
+    if (view.replay_status[0]) {
+        frame_line("【操作】 [空格]=播放/暂停  [+/=]=加速  [-]=减速  [B]=倒放  [,/.]=单帧  [0-9]=跳到 0%%~90%%  [E]=末尾  [[ ]]=历史缩放  [Q]=退出");
+        return;
+    }
+    frame_line("【操作】 [空格]=暂停/继续  [+/=]=加速  [-]=减速  [F]=全速  [P]=性能  [D]=分布  [[ ]]=历史缩放  [R]=重置  [S]=保存  [Q]=退出");
+}
@@ -0,0 +1,56 @@
+﻿// 终端渲染：模拟线程把世界复制为画面 (publish_view)，渲染线程把画面拼成一帧，
+// 只输出与上一帧不同的格子和文字行
+#pragma once
+
+#include "ecosystem.h"
+#include "history.h"
+#include <mutex>
+
+#define MAX_TEXT_LINES 48      // 地图下方文字区的最多行数
+#define TEXT_LINE_SIZE 256     // 文字区每行的最大字节数（含颜色转义）
+#define RENDER_FPS 30          // 交互模式的刷新帧率，与模拟速度无关
+
+// 模拟线程发布给渲染线程的画面，受 view_mutex 保护；渲染线程取走后置 view_wanted 请求下一份，
+// 因此复制画面的次数不超过帧率，与模拟速度无关
+typedef struct {
+    unsigned char* glyphs; // 每格的显示符号编号
+    int cells;             // glyphs 的格数，地图尺寸改变时重新分配
+    int tick, season;
+    int grass;
+    int counts[ANIMAL_SPECIES]; // 各物种的数量与历史峰值、谷值（不计 0，没有过时为 0），按物种编号
+    int max_counts[ANIMAL_SPECIES], min_counts[ANIMAL_SPECIES];
+    unsigned int seed;
+    HistoryBucket chart[HISTORY_CHART_WIDTH]; // 历史曲线每列的统计，发布时按当前缩放档从 history 取出
+    int chart_from, chart_to;                 // 曲线覆盖的回合范围 [from, to)
+    char replay_status[TEXT_LINE_SIZE];       // 回放模式的状态行，非空时代替速度一行并换用回放的操作说明
+    int has_census;                           // 以下分布是否有效；录制文件不保存个体，回放时为 0
+    SpeciesCensus census[ANIMAL_SPECIES];
+    int densest_row, densest_col;             // 动物最多的区块（-1 表示没有动物）及其中的动物与青草数
+    int densest_animals, densest_grass;
+    int serial; // 每发布一次加一
+} DisplayView;
+
+extern DisplayView view;
+extern std::mutex view_mutex; // 同时保护 message/message_timeout
+extern std::atomic<int> view_wanted;
+extern std::atomic<int> show_profile; // 是否显示性能统计面板
+extern std::atomic<int> show_census;  // 是否显示分布面板
+extern std::atomic<int> history_zoom; // 历史曲线的缩放档，下标见 history_zoom_ticks
+
+// 交互控制：由输入线程修改，模拟线程和渲染线程读取
+extern std::atomic<int> paused;
+extern std::atomic<int> delay_ms; // 每回合的目标间隔，0 表示全速
+
+extern char message[128];
+extern int message_timeout; // 提示信息还要显示的帧数
+
+void publish_view();
+int map_glyph(int i, int j);
+#define MAP_GLYPHS (3 + ANIMAL_SPECIES) // map_glyph 的取值个数
+void set_message(const char* msg);
+void census_bars(const int* bins, char* out);
+size_t render_compose();
+void render_frame();
+void render_invalidate();
+void render_free();
+void render_release();
@@ -0,0 +1,428 @@
+﻿#define _CRT_SECURE_NO_WARNINGS
+#include "replay.h"
+#include "render.h"
+#include <mutex>
+
+// 回放时历史曲线的窗口不超过这么多帧就逐帧统计，更宽的窗口用打开时建立的 history
+#define REPLAY_EXACT_CHART 50000
+
+// 录制状态：记录由模拟线程写入；按键来自输入线程，先放进 rec_inputs，写下一帧时一并写出
+static FILE* rec_file = NULL;
+static unsigned char* rec_prev = NULL; // 上一帧的画面
+static unsigned char* rec_cur = NULL;
+static unsigned char* rec_buf = NULL;  // 组装一条记录的负载
+static int rec_cells = 0;
+static int rec_frames = 0;
+static int rec_ok = 1;
+static int rec_last_key = 0;           // 上一个关键帧的帧号
+static size_t rec_key_bytes = 0;       // 上一个关键帧的大小
+static size_t rec_delta_bytes = 0;     // 此后差分的总大小
+static std::mutex rec_mutex;
+static int rec_inputs[RECORD_MAX_INPUTS];
+static int rec_input_count = 0;
+
+static unsigned char* put_varint(unsigned char* p, unsigned long long v) {
+    while (v >= 0x80) {
+        *p++ = (unsigned char)(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (unsigned char)v;
+    return p;
+}
+
+// 读一个变长整数；越界或超长时返回 NULL
+static const unsigned char* get_varint(const unsigned char* p, const unsigned char* end, unsigned long long* v) {
+    unsigned long long x = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7) {
+        unsigned char b = *p++;
+        x |= (unsigned long long)(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            *v = x;
+            return p;
+        }
+    }
+    return NULL;
+}
+
+static void write_record(int type, const unsigned char* payload, size_t len) {
+    unsigned char head[16];
+    head[0] = (unsigned char)type;
+    size_t head_len = put_varint(head + 1, len) - head;
+    if (fwrite(head, 1, head_len, rec_file) != head_len || fwrite(payload, 1, len, rec_file) != len) rec_ok = 0;
+}
+
+static unsigned char* put_info(unsigned char* p) {
+    p = put_varint(p, (unsigned int)tick);
+    p = put_varint(p, (unsigned int)season_at(tick));
+    p = put_varint(p, (unsigned int)grass_count);
+    for (int s = 0; s < ANIMAL_SPECIES; s++) p = put_varint(p, (unsigned int)species_count[s]);
+    for (int s = 0; s < ANIMAL_SPECIES; s++) p = put_varint(p, (unsigned int)species_max[s]);
+    for (int s = 0; s < ANIMAL_SPECIES; s++) p = put_varint(p, (unsigned int)(species_min[s] == INT_MAX ? 0 : species_min[s]));
+    return put_varint(p, rand_seed);
+}
+
+static int differs(const unsigned char* a, const unsigned char* b, int pos, int n) {
+    return pos < n && a[pos] != b[pos];
+}
+
+// 与上一帧的异或差分。不变的格子按 8 字节一组跳过；变化格之间不超过两格的空隙并入同一段
+// （异或值为 0），少写一对长度
+static unsigned char* encode_delta(unsigned char* p, const unsigned char* prev, const unsigned char* cur, int n) {
+    int pos = 0;
+    while (pos < n) {
+        int start = pos;
+        while (pos + 8 <= n) {
+            unsigned long long a, b;
+            memcpy(&a, prev + pos, 8);
+            memcpy(&b, cur + pos, 8);
+            if (a != b) break;
+            pos += 8;
+        }
+        while (pos < n && prev[pos] == cur[pos]) pos++;
+        if (pos == n) break; // 末尾不变的格子不写
+        int changed = pos;
+        while (differs(prev, cur, pos, n) || differs(prev, cur, pos + 1, n) || differs(prev, cur, pos + 2, n)) pos++;
+        p = put_varint(p, (unsigned)(changed - start));
+        p = put_varint(p, (unsigned)(pos - changed));
+        for (int k = changed; k < pos; k += 2) {
+            int lo = prev[k] ^ cur[k];
+            int hi = k + 1 < pos ? prev[k + 1] ^ cur[k + 1] : 0;
+            *p++ = (unsigned char)(lo | hi << 4);
+        }
+    }
+    return p;
+}
+
+// 关键帧每段用 3 位存符号
+static_assert(MAP_GLYPHS <= 8, "显示符号超过 8 种，关键帧的游程编码需要加宽");
+
+static unsigned char* encode_keyframe(unsigned char* p, const unsigned char* cur, int n) {
+    for (int pos = 0; pos < n;) {
+        int start = pos, v = cur[pos];
+        while (pos < n && cur[pos] == v) pos++;
+        p = put_varint(p, (unsigned long long)(pos - start) << 3 | (unsigned)v);
+    }
+    return p;
+}
+
+// 开始录制到 path，地图尺寸此后不能改变；成功返回 1
+int recorder_open(const char* path) {
+    rec_cells = grid_w * grid_h;
+    rec_prev = (unsigned char*)calloc(rec_cells, 1); // 第 0 帧相对全空地图
+    rec_cur = (unsigned char*)malloc(rec_cells);
+    // 差分最坏每格约 1.5 字节，FrameInfo 的每个变长整数至多 5 字节
+    rec_buf = (unsigned char*)malloc((size_t)rec_cells * 2 + 5 * FRAME_INFO_FIELDS + 64);
+    rec_file = rec_prev && rec_cur && rec_buf ? fopen(path, "wb") : NULL;
+    if (!rec_file) {
+        free(rec_prev);
+        free(rec_cur);
+        free(rec_buf);
+        rec_prev = rec_cur = rec_buf = NULL;
+        return 0;
+    }
+    setvbuf(rec_file, NULL, _IOFBF, 1 << 20);
+    RecordHeader h;
+    memset(&h, 0, sizeof(h));
+    strcpy(h.magic, "ECOREC");
+    h.version = RECORD_VERSION;
+    h.byte_order = 0x01020304;
+    h.grid_w = grid_w;
+    h.grid_h = grid_h;
+    h.start_season = start_season;
+    h.rand_seed = rand_seed;
+    h.species = ANIMAL_SPECIES;
+    h.init_grass = init_grass;
+    h.grass_skip = grass_skip;
+    for (int s = 0; s < ANIMAL_SPECIES; s++) {
+        h.init_counts[s] = species_init[s];
+        h.breed_probs[s] = species_breed_prob[s];
+        h.breed_energies[s] = species_breed_energy[s];
+    }
+    rec_ok = fwrite(&h, sizeof(h), 1, rec_file) == 1;
+    rec_frames = 0;
+    rec_input_count = 0;
+    rec_delta_bytes = rec_key_bytes = 0;
+    return rec_ok;
+}
+
+// 模拟线程在开始时、每回合结束和重置之后各调用一次，记录当前世界为一帧
+void recorder_frame() {
+    if (!rec_file) return;
+    {
+        std::lock_guard<std::mutex> lock(rec_mutex);
+        for (int k = 0; k < rec_input_count; k++) {
+            unsigned char* p = put_varint(rec_buf, (unsigned)rec_frames);
+            p = put_varint(p, (unsigned)rec_inputs[k]);
+            write_record('I', rec_buf, p - rec_buf);
+        }
+        rec_input_count = 0;
+    }
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < grid_h; i++) {
+        for (int j = 0; j < grid_w; j++) rec_cur[(size_t)i * grid_w + j] = (unsigned char)map_glyph(i, j);
+    }
+    unsigned char* p = encode_delta(put_info(rec_buf), rec_prev, rec_cur, rec_cells);
+    write_record('D', rec_buf, p - rec_buf);
+    rec_delta_bytes += p - rec_buf;
+    if (rec_frames == 0 || rec_delta_bytes >= rec_key_bytes * RECORD_KEYFRAME_RATIO
+        || rec_frames - rec_last_key >= RECORD_KEYFRAME_INTERVAL) {
+        p = encode_keyframe(put_info(rec_buf), rec_cur, rec_cells);
+        write_record('K', rec_buf, p - rec_buf);
+        rec_last_key = rec_frames;
+        rec_key_bytes = p - rec_buf;
+        rec_delta_bytes = 0;
+    }
+    unsigned char* t = rec_prev;
+    rec_prev = rec_cur;
+    rec_cur = t;
+    rec_frames++;
+}
+
+// 输入线程每读到一个按键调用一次
+void recorder_input(int key) {
+    if (!rec_file) return;
+    std::lock_guard<std::mutex> lock(rec_mutex);
+    if (rec_input_count < RECORD_MAX_INPUTS) rec_inputs[rec_input_count++] = key;
+}
+
+// 结束录制；返回 0 表示写入过程中出错（文件可能不完整）
+int recorder_close() {
+    if (!rec_file) return 1;
+    if (fclose(rec_file) != 0) rec_ok = 0;
+    rec_file = NULL;
+    free(rec_prev);
+    free(rec_cur);
+    free(rec_buf);
+    rec_prev = rec_cur = rec_buf = NULL;
+    return rec_ok;
+}
+
+// 解析 off 处的一条记录，返回下一条记录的偏移；记录不完整时返回 -1
+static long long read_record(const Replay* r, long long off, int* type, const unsigned char** payload, const unsigned char** end) {
+    const unsigned char* base = r->data + off;
+    const unsigned char* limit = r->data + r->size;
+    unsigned long long len;
+    if (base >= limit) return -1;
+    const unsigned char* p = get_varint(base + 1, limit, &len);
+    if (!p || len > (unsigned long long)(limit - p)) return -1;
+    *type = base[0];
+    *payload = p;
+    *end = p + len;
+    return *end - r->data;
+}
+
+static const unsigned char* get_info(const unsigned char* p, const unsigned char* end, FrameInfo* info) {
+    unsigned long long v[FRAME_INFO_FIELDS];
+    for (int k = 0; k < FRAME_INFO_FIELDS; k++) {
+        if (!(p = get_varint(p, end, &v[k]))) return NULL;
+    }
+    info->tick = (int)v[0];
+    info->season = (int)(v[1] & 3);
+    info->grass = (int)v[2];
+    for (int s = 0; s < ANIMAL_SPECIES; s++) {
+        info->counts[s] = (int)v[3 + s];
+        info->max_counts[s] = (int)v[3 + ANIMAL_SPECIES + s];
+        info->min_counts[s] = (int)v[3 + 2 * ANIMAL_SPECIES + s];
+    }
+    info->seed = (unsigned int)v[FRAME_INFO_FIELDS - 1];
+    return p;
+}
+
+// 打开录制文件并建立索引，同时用每帧的数量建立 history 供历史曲线使用；失败时输出原因并返回 0
+int replay_open(Replay* r, const char* path) {
+    memset(r, 0, sizeof(*r));
+    r->current = -1;
+    r->data = map_file(path, &r->size);
+    if (!r->data) {
+        fprintf(stderr, "无法读取录制文件: %s\n", path);
+        return 0;
+    }
+    const RecordHeader* h = (const RecordHeader*)r->data;
+    if (r->size < sizeof(RecordHeader) || memcmp(h->magic, "ECOREC", 7) != 0 || h->byte_order != 0x01020304
+        || h->version != RECORD_VERSION || h->species != ANIMAL_SPECIES || h->grid_w < 1 || h->grid_h < 1 || h->grid_w > 65536 || h->grid_h > 65536
+        || (long long)h->grid_w * h->grid_h > INT_MAX) {
+        fprintf(stderr, "不是有效的录制文件（或由不同版本写出）: %s\n", path);
+        replay_close(r);
+        return 0;
+    }
+    r->header = *h;
+    r->cells = h->grid_w * h->grid_h;
+
+    // 第一遍只计数，第二遍填索引
+    for (int pass = 0; pass < 2; pass++) {
+        int frames = 0, keys = 0, inputs = 0;
+        long long off = sizeof(RecordHeader), next;
+        int type;
+        const unsigned char *p, *end;
+        while ((next = read_record(r, off, &type, &p, &end)) >= 0) {
+            FrameInfo info;
+            unsigned long long frame, key;
+            if (type == 'D' && get_info(p, end, &info)) {
+                if (pass) {
+                    r->frame_offsets[frames] = off;
+                    memcpy(r->counts + (size_t)frames * ANIMAL_SPECIES, info.counts, sizeof(info.counts));
+                }
+                frames++;
+            }
+            else if (type == 'K' && frames > 0) {
+                if (pass) {
+                    r->key_frames[keys] = frames - 1;
+                    r->key_offsets[keys] = off;
+                }
+                keys++;
+            }
+            else if (type == 'I' && (p = get_varint(p, end, &frame)) && get_varint(p, end, &key)) {
+                if (pass) {
+                    r->input_frames[inputs] = (int)frame;
+                    r->input_keys[inputs] = (int)key;
+                }
+                inputs++;
+            }
+            off = next;
+        }
+        if (pass == 0) {
+            if (frames == 0 || keys == 0) break;
+            r->frame_offsets = (long long*)malloc(sizeof(long long) * frames);
+            r->counts = (int*)malloc(sizeof(int) * ANIMAL_SPECIES * frames);
+            r->key_frames = (int*)malloc(sizeof(int) * keys);
+            r->key_offsets = (long long*)malloc(sizeof(long long) * keys);
+            r->input_frames = (int*)malloc(sizeof(int) * (inputs + 1));
+            r->input_keys = (int*)malloc(sizeof(int) * (inputs + 1));
+            r->glyphs = (unsigned char*)malloc(r->cells);
+            if (!r->frame_offsets || !r->counts || !r->key_frames || !r->key_offsets
+                || !r->input_frames || !r->input_keys || !r->glyphs) {
+                fprintf(stderr, "内存不足：无法回放 %s\n", path);
+                replay_close(r);
+                return 0;
+            }
+        }
+        r->frames = frames;
+        r->keys = keys;
+        r->inputs = inputs;
+    }
+    if (r->frames == 0 || r->keys == 0 || r->key_frames[0] != 0 || !replay_seek(r, 0)) {
+        fprintf(stderr, "录制文件已损坏或没有完整的帧: %s\n", path);
+        replay_close(r);
+        return 0;
+    }
+    history_reset(0);
+    for (int f = 0; f < r->frames; f++) history_add(r->counts + (size_t)f * ANIMAL_SPECIES);
+    return 1;
+}
+
+void replay_close(Replay* r) {
+    if (r->data) unmap_file(r->data, r->size);
+    free(r->frame_offsets);
+    free(r->counts);
+    free(r->key_frames);
+    free(r->key_offsets);
+    free(r->input_frames);
+    free(r->input_keys);
+    free(r->glyphs);
+    memset(r, 0, sizeof(*r));
+    r->current = -1;
+}
+
+// 把第 frame 帧的差分异或到画面上：在第 frame-1 帧上得到第 frame 帧，在第 frame 帧上得到第 frame-1 帧
+static int apply_delta(Replay* r, int frame) {
+    int type;
+    const unsigned char *p, *end;
+    FrameInfo info;
+    if (read_record(r, r->frame_offsets[frame], &type, &p, &end) < 0) return 0;
+    if (!(p = get_info(p, end, &info))) return 0;
+    unsigned char* g = r->glyphs;
+    unsigned long long pos = 0, same, changed;
+    while (p < end) {
+        if (!(p = get_varint(p, end, &same)) || !(p = get_varint(p, end, &changed))) return 0;
+        pos += same;
+        if (pos + changed > (unsigned long long)r->cells || (changed + 1) / 2 > (unsigned long long)(end - p)) return 0;
+        unsigned char* c = g + pos;
+        unsigned long long k = 0;
+        for (; k + 1 < changed; k += 2, p++) {
+            c[k] ^= *p & 15;
+            c[k + 1] ^= *p >> 4;
+        }
+        if (k < changed) c[k] ^= *p++ & 15;
+        pos += changed;
+    }
+    return 1;
+}
+
+static int decode_keyframe(Replay* r, int key) {
+    int type;
+    const unsigned char *p, *end;
+    FrameInfo info;
+    if (read_record(r, r->key_offsets[key], &type, &p, &end) < 0) return 0;
+    if (!(p = get_info(p, end, &info))) return 0;
+    unsigned long long pos = 0, run;
+    while (p < end) {
+        if (!(p = get_varint(p, end, &run)) || (run >> 3) > (unsigned long long)r->cells - pos) return 0;
+        memset(r->glyphs + pos, (int)(run & 7), (size_t)(run >> 3));
+        pos += run >> 3;
+    }
+    return pos == (unsigned long long)r->cells;
+}
+
+// 跳到第 frame 帧（越界时取首尾）。离当前帧不远时直接逐帧前进或后退，
+// 否则从不晚于目标的最近关键帧出发；成功返回 1
+int replay_seek(Replay* r, int frame) {
+    if (frame < 0) frame = 0;
+    if (frame >= r->frames) frame = r->frames - 1;
+    int lo = 0, hi = r->keys - 1;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        if (r->key_frames[mid] <= frame) lo = mid;
+        else hi = mid - 1;
+    }
+    int key = r->key_frames[lo];
+    int ok = 1;
+    if (r->current >= 0 && r->current > frame && r->current - frame <= frame - key) {
+        for (; ok && r->current > frame; r->current--) ok = apply_delta(r, r->current);
+    }
+    else {
+        if (r->current < key || r->current > frame) {
+            ok = decode_keyframe(r, lo);
+            r->current = key;
+        }
+        for (; ok && r->current < frame; r->current++) ok = apply_delta(r, r->current + 1);
+    }
+    if (!ok) {
+        r->current = -1;
+        return 0;
+    }
+    int type;
+    const unsigned char *p, *end;
+    if (read_record(r, r->frame_offsets[frame], &type, &p, &end) < 0 || !get_info(p, end, &r->info)) {
+        r->current = -1;
+        return 0;
+    }
+    return 1;
+}
+
+// 不晚于第 frame 帧的最后一次按键的下标，没有时返回 -1
+int replay_last_input(const Replay* r, int frame) {
+    int lo = 0, hi = r->inputs;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (r->input_frames[mid] <= frame) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo - 1;
+}
+
+// 与 history_chart 相同的分列方式，窗口较窄时逐帧统计
+void replay_chart(const Replay* r, int from, int to, int columns, HistoryBucket* out) {
+    long long range = (long long)to - from;
+    if (range > REPLAY_EXACT_CHART) {
+        history_chart(from, to, columns, out);
+        return;
+    }
+    for (int c = 0; c < columns; c++) {
+        HistoryBucket* col = &out[c];
+        history_bucket_clear(col);
+        long long a = from + range * c / columns, b = from + range * (c + 1) / columns;
+        if (b <= a) b = a + 1;
+        for (long long f = a < 0 ? 0 : a; f < b && f < r->frames; f++)
+            history_bucket_count(col, r->counts + (size_t)f * ANIMAL_SPECIES);
+    }
+}
@@ -0,0 +1,77 @@
+﻿// 录制与回放：录制文件保存种子、参数、用户按键和每回合的画面（每格的显示符号，见 map_glyph）。
+// 每帧与上一帧逐格异或，只编码变化的格子，并不时另存一个整帧的关键帧。
+// 异或差分可以双向使用：把第 t 帧的差分作用在第 t 帧上就回到第 t-1 帧，
+// 因此回放时前进、后退都只解码差分，跳转时从最近的关键帧出发，不需要重新模拟
+#pragma once
+
+#include "ecosystem.h"
+#include "history.h"
+
+#define RECORD_VERSION 2
+#define RECORD_KEYFRAME_INTERVAL 256 // 画面几乎不变时关键帧的最大间隔（帧）
+#define RECORD_MAX_INPUTS 256        // 两帧之间最多记录的按键数
+// 两个关键帧之间的差分总字节数达到上一个关键帧的这么多倍时写下一个关键帧：
+// 关键帧多占约 1/8 的空间，跳转时解码的数据量与画面变化的快慢无关
+#define RECORD_KEYFRAME_RATIO 8
+
+// 文件头之后是一串记录：类型字节、负载长度（变长整数）、负载。
+//   'D' 每帧一条：FrameInfo 各字段（变长整数），再是与上一帧的异或差分：
+//       交替的“不变格数、变化格数”（变长整数），变化格的异或值每字节两格（低 4 位在前）
+//   'K' 关键帧，紧跟在同一帧的 'D' 之后：FrameInfo，再是整帧的游程编码，每段一个变长整数 (长度 << 3 | 符号)
+//   'I' 用户按键：按下时下一帧的编号、按键（变长整数），在该帧的 'D' 之前
+// 第 0 帧的差分相对全空地图，且第 0 帧总有关键帧；程序中途退出时，末尾不完整的记录在回放时忽略
+typedef struct {
+    char magic[8];           // "ECOREC"
+    unsigned int version;
+    unsigned int byte_order; // 0x01020304
+    int grid_w, grid_h;
+    int start_season;
+    unsigned int rand_seed;  // 开始录制时的种子；重置后的种子见每帧的 FrameInfo
+    int species;             // 物种数 (ANIMAL_SPECIES)，各物种的数组与每帧的数量都按物种编号排列
+    int init_grass, grass_skip;
+    int init_counts[ANIMAL_SPECIES];
+    double breed_probs[ANIMAL_SPECIES];
+    int breed_energies[ANIMAL_SPECIES];
+} RecordHeader;
+
+// 每帧附带的状态区数据，与 DisplayView 的同名字段一致；写入文件时依次为 tick、season、grass，
+// 再是各物种的数量、峰值、谷值，最后是种子
+typedef struct {
+    int tick, season;
+    int grass;
+    int counts[ANIMAL_SPECIES];
+    int max_counts[ANIMAL_SPECIES], min_counts[ANIMAL_SPECIES];
+    unsigned int seed;
+} FrameInfo;
+#define FRAME_INFO_FIELDS (4 + 3 * ANIMAL_SPECIES) // FrameInfo 的变长整数个数
+
+// 回放：整个文件映射到内存，打开时扫描一遍建立每帧和关键帧的索引
+typedef struct {
+    const unsigned char* data;
+    size_t size;
+    RecordHeader header;
+    int cells;
+    int frames;
+    long long* frame_offsets;              // 每帧 'D' 记录的起始偏移
+    int keys;
+    int* key_frames;                       // 有关键帧的帧号（递增）
+    long long* key_offsets;
+    int inputs;
+    int* input_frames;                     // 按键前最后一帧的下一帧
+    int* input_keys;
+    int* counts;                           // 每帧的各物种数量（每帧 ANIMAL_SPECIES 个），画历史曲线用
+    unsigned char* glyphs;                 // 当前帧的画面
+    int current;                           // 当前帧，-1 表示尚未解码
+    FrameInfo info;                        // 当前帧的状态
+} Replay;
+
+int recorder_open(const char* path);
+void recorder_frame();
+void recorder_input(int key);
+int recorder_close();
+
+int replay_open(Replay* r, const char* path);
+void replay_close(Replay* r);
+int replay_seek(Replay* r, int frame);
+int replay_last_input(const Replay* r, int frame);
+void replay_chart(const Replay* r, int from, int to, int columns, HistoryBucket* out);
@@ -0,0 +1,72 @@
+﻿// 物种特性表：每种动物的食物、搜索半径、移动消耗、进食所得、繁殖参数和后代能量集中在 SPECIES 中。
+// 逐个体的内核 (ecosystem.cpp) 以物种编号为模板参数实例化，特性在编译期就是常量，
+// 热循环里没有按类型的分支。增加物种：在 EntityType 末尾加一个类型、把 ANIMAL_SPECIES 加一，
+// 在表中加一行，再在 ecosystem.cpp 的各物种参数数组中补上它的默认值。数量、事件与统计、
+// 命令行参数、存档、录制和监控输出都按物种编号遍历此表，不需要另外改动
+#pragma once
+
+#include "ecosystem.h"
+
+typedef struct {
+    EntityType type;
+    const char* name;
+    const char* key;          // 复数英文名：命令行 --<key> 为初始数量，也是 CSV 列与 JSON 的键
+    const char* prefix;       // 单数英文名：--<prefix>-breed、--<prefix>-breed-energy 与 <prefix>_births 等列
+    char glyph;               // 地图上的字符与颜色
+    int color;
+    EntityType food;          // 觅食目标：GRASS 或 rank 更小的动物
+    int rank;                 // 移动裁决的先后：rank 小的先走；rank 相同的物种之间按格子编号争位
+    int search_radius;        // 找食物的方框半径
+    int move_cost;            // 每回合的移动消耗，冬季加倍
+    int food_energy;          // 吃到食物时获得的能量（草：走到草上；猎物：猎物留在捕食者走进的格子里）
+    int offspring_energy;     // 后代的初始能量，同时从父代扣除
+    int spawn_energy;         // 初始放置时的能量
+    int age_base, age_spread; // 寿命 = age_base + [0, age_spread)
+} SpeciesTraits;
+// 可由命令行修改的初始数量与繁殖参数不在表中，见 species_init、species_breed_prob、species_breed_energy
+
+#define SPECIES_RANKS 2 // rank 的取值个数（0 = 被捕食者，1 = 捕食者）
+
+static constexpr SpeciesTraits SPECIES[ANIMAL_SPECIES] = {
+    { RABBIT, "兔子", "rabbits", "rabbit", 'r', 36, GRASS,  0, 4, 1, 10, 10, 12, 30, 20 },
+    { WOLF,   "狼",   "wolves",  "wolf",   'W', 35, RABBIT, 1, 6, 2, 25, 15, 25, 50, 20 },
+    // 狐狸与狼争抢兔子：搜索半径较小、移动更省力，繁殖更快
+    { FOX,    "狐狸", "foxes",   "fox",    'F', 33, RABBIT, 1, 5, 1, 18, 12, 20, 40, 20 },
+};
+
+// 编译期检查：表按类型顺序排列，食物的 rank 比吃它的物种小，rank 在范围内
+constexpr int species_table_valid(int s) {
+    return s == ANIMAL_SPECIES
+        || (SPECIES[s].type == (EntityType)(RABBIT + s) && SPECIES[s].rank < SPECIES_RANKS
+            && (SPECIES[s].food == GRASS || SPECIES[SPECIES_OF(SPECIES[s].food)].rank < SPECIES[s].rank)
+            && species_table_valid(s + 1));
+}
+static_assert(species_table_valid(0), "物种特性表与 EntityType 不一致，或食物的 rank 不小于捕食者");
+
+// 编译期检查：打包的 Entity 放得下类型、寿命和能量。能量每回合至多增加 food_energy，
+// 起点不超过初始能量、后代能量与繁殖后的下限 5，至多活 寿命 个回合
+constexpr int trait_max(int a, int b) { return a > b ? a : b; }
+constexpr int species_fits_entity(int s) {
+    return s == ANIMAL_SPECIES
+        || (SPECIES[s].age_base + SPECIES[s].age_spread - 1 <= ENTITY_AGE_MAX
+            && trait_max(trait_max(SPECIES[s].spawn_energy, SPECIES[s].offspring_energy), 5)
+               + (SPECIES[s].age_base + SPECIES[s].age_spread - 1) * SPECIES[s].food_energy <= ENTITY_ENERGY_MAX
+            && species_fits_entity(s + 1));
+}
+static_assert(ENTITY_TYPES <= 8 && species_fits_entity(0), "Entity 的位宽不够：类型、寿命或能量超出范围");
+
+// 对每个物种依次调用 K<S>::run(args...)，S 为编译期常量
+template <template <int> class K, int S = 0>
+struct ForEachSpecies {
+    template <typename... Args>
+    static void run(Args... args) {
+        K<S>::run(args...);
+        ForEachSpecies<K, S + 1>::run(args...);
+    }
+};
+
+template <template <int> class K>
+struct ForEachSpecies<K, ANIMAL_SPECIES> {
+    template <typename... Args>
+    static void run(Args...) {}
+};
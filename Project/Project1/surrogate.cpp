@@ -0,0 +1,215 @@
+﻿#define _CRT_SECURE_NO_WARNINGS
+#include "surrogate.h"
+
+static const char* equation_names[3] = { "grass", "rabbit", "wolf" };
+
+static void surrogate_features(double g, double r, double w, double* x) {
+    x[0] = 1.0;
+    x[1] = g;
+    x[2] = r;
+    x[3] = w;
+    x[4] = g * r;
+    x[5] = r * w;
+    x[6] = g * w;
+}
+
+static double* model_row(SurrogateModel* model, int eq, int s) {
+    return eq == 0 ? model->grass[s] : eq == 1 ? model->rabbit[s] : model->wolf[s];
+}
+
+// 一个回合的样本：回合开始前的状态 before，回合结束后的状态 after，season 为该回合的季节。
+// 兔子和狼的方程以 r·x、w·x 为自变量，直接拟合数量的变化量，小种群的随机波动权重自然较小
+void surrogate_fit_add(SurrogateFit* fit, int season, double cells, const SurrogateState* before, const SurrogateState* after) {
+    double g = before->grass / cells, r = before->rabbits / cells, w = before->wolves / cells;
+    double x[SURROGATE_TERMS];
+    surrogate_features(g, r, w, x);
+    const double scale[3] = { 1.0, r, w };
+    const double y[3] = {
+        (after->grass - before->grass) / cells,
+        (after->rabbits - before->rabbits) / cells,
+        (after->wolves - before->wolves) / cells
+    };
+    for (int eq = 0; eq < 3; eq++) {
+        double z[SURROGATE_TERMS];
+        for (int k = 0; k < SURROGATE_TERMS; k++) z[k] = scale[eq] * x[k];
+        for (int a = 0; a < SURROGATE_TERMS; a++) {
+            for (int b = 0; b < SURROGATE_TERMS; b++) fit->xtx[eq][season][a][b] += z[a] * z[b];
+            fit->xty[eq][season][a] += z[a] * y[eq];
+        }
+        fit->yty[eq][season] += y[eq] * y[eq];
+        fit->ysum[eq][season] += y[eq];
+    }
+    fit->samples[season]++;
+}
+
+// 解 (A + λI) c = b，λ 为对角线最大值的 1e-9 倍：某一项始终为 0（如没有狼）时其系数取 0，
+// 而不是让方程奇异
+static void solve_normal(const double a_in[SURROGATE_TERMS][SURROGATE_TERMS], const double* b_in, double* c) {
+    double a[SURROGATE_TERMS][SURROGATE_TERMS + 1];
+    double diag = 0.0;
+    for (int i = 0; i < SURROGATE_TERMS; i++) diag = a_in[i][i] > diag ? a_in[i][i] : diag;
+    double lambda = diag * 1e-9 + 1e-300;
+    for (int i = 0; i < SURROGATE_TERMS; i++) {
+        for (int j = 0; j < SURROGATE_TERMS; j++) a[i][j] = a_in[i][j] + (i == j ? lambda : 0.0);
+        a[i][SURROGATE_TERMS] = b_in[i];
+    }
+    // 列主元高斯消元
+    for (int col = 0; col < SURROGATE_TERMS; col++) {
+        int pivot = col;
+        for (int i = col + 1; i < SURROGATE_TERMS; i++) {
+            if (fabs(a[i][col]) > fabs(a[pivot][col])) pivot = i;
+        }
+        for (int j = 0; j <= SURROGATE_TERMS; j++) {
+            double t = a[col][j]; a[col][j] = a[pivot][j]; a[pivot][j] = t;
+        }
+        for (int i = col + 1; i < SURROGATE_TERMS; i++) {
+            double f = a[i][col] / a[col][col];
+            for (int j = col; j <= SURROGATE_TERMS; j++) a[i][j] -= f * a[col][j];
+        }
+    }
+    for (int i = SURROGATE_TERMS - 1; i >= 0; i--) {
+        double sum = a[i][SURROGATE_TERMS];
+        for (int j = i + 1; j < SURROGATE_TERMS; j++) sum -= a[i][j] * c[j];
+        c[i] = sum / a[i][i];
+    }
+}
+
+// 逐季节求解三个方程的系数；没有样本的季节系数为 0（数量保持不变）。返回有样本的季节数
+int surrogate_fit_solve(const SurrogateFit* fit, SurrogateModel* model) {
+    memset(model, 0, sizeof(*model));
+    model->rabbit_breed_prob = species_breed_prob[SPECIES_OF(RABBIT)];
+    model->wolf_breed_prob = species_breed_prob[SPECIES_OF(WOLF)];
+    model->rabbit_breed_energy = species_breed_energy[SPECIES_OF(RABBIT)];
+    model->wolf_breed_energy = species_breed_energy[SPECIES_OF(WOLF)];
+    int seasons = 0;
+    for (int s = 0; s < 4; s++) {
+        long long n = fit->samples[s];
+        model->samples[s] = n;
+        if (n == 0) continue;
+        seasons++;
+        for (int eq = 0; eq < 3; eq++) {
+            double* c = model_row(model, eq, s);
+            solve_normal(fit->xtx[eq][s], fit->xty[eq][s], c);
+            // 残差平方和 = y·y - 2 c·(Xᵀy) + cᵀ(XᵀX)c
+            double ss_res = fit->yty[eq][s];
+            for (int a = 0; a < SURROGATE_TERMS; a++) {
+                ss_res -= 2.0 * c[a] * fit->xty[eq][s][a];
+                for (int b = 0; b < SURROGATE_TERMS; b++) ss_res += c[a] * fit->xtx[eq][s][a][b] * c[b];
+            }
+            double ss_tot = fit->yty[eq][s] - fit->ysum[eq][s] * fit->ysum[eq][s] / n;
+            model->r2[s][eq] = ss_tot > 0.0 ? 1.0 - ss_res / ss_tot : 0.0;
+        }
+    }
+    return seasons;
+}
+
+// 推进一个回合。三个方程都用回合开始时的状态求变化量；不足半只的种群视为灭绝，
+// 此后保持为 0（人均增长率乘以 0）
+void surrogate_step(const SurrogateModel* model, int season, double cells, SurrogateState* s) {
+    double g = s->grass / cells, r = s->rabbits / cells, w = s->wolves / cells;
+    double x[SURROGATE_TERMS];
+    surrogate_features(g, r, w, x);
+    double dg = 0.0, rate_r = 0.0, rate_w = 0.0;
+    for (int k = 0; k < SURROGATE_TERMS; k++) {
+        dg += model->grass[season][k] * x[k];
+        rate_r += model->rabbit[season][k] * x[k];
+        rate_w += model->wolf[season][k] * x[k];
+    }
+    g += dg;
+    r += r * rate_r;
+    w += w * rate_w;
+
+    // 每格至多一个实体：动物先占格，青草只能长在剩下的格子上
+    if (r < 0.0) r = 0.0;
+    if (w < 0.0) w = 0.0;
+    if (r + w > 1.0) {
+        double f = 1.0 / (r + w);
+        r *= f;
+        w *= f;
+    }
+    if (g > 1.0 - r - w) g = 1.0 - r - w;
+    if (g < 0.0) g = 0.0;
+    s->grass = g * cells;
+    s->rabbits = r * cells < 0.5 ? 0.0 : r * cells;
+    s->wolves = w * cells < 0.5 ? 0.0 : w * cells;
+}
+
+// 从 first_tick 推进到 last_tick，统计口径与 record_tick_stats 相同
+void surrogate_run(const SurrogateModel* model, double cells, int first_tick, int last_tick,
+    const SurrogateState* start, SurrogateResult* out) {
+    SurrogateState s = *start;
+    memset(out, 0, sizeof(*out));
+    out->rabbit_extinct_tick = s.rabbits == 0.0 ? first_tick : -1;
+    out->wolf_extinct_tick = s.wolves == 0.0 ? first_tick : -1;
+    for (int t = first_tick; t < last_tick; t++) {
+        surrogate_step(model, season_at(t), cells, &s);
+        if (s.rabbits > out->max_rabbits) out->max_rabbits = s.rabbits;
+        if (s.wolves > out->max_wolves) out->max_wolves = s.wolves;
+        if (s.rabbits > 0.0 && (out->min_rabbits == 0.0 || s.rabbits < out->min_rabbits)) out->min_rabbits = s.rabbits;
+        if (s.wolves > 0.0 && (out->min_wolves == 0.0 || s.wolves < out->min_wolves)) out->min_wolves = s.wolves;
+        if (s.rabbits == 0.0 && out->rabbit_extinct_tick < 0) out->rabbit_extinct_tick = t + 1;
+        if (s.wolves == 0.0 && out->wolf_extinct_tick < 0) out->wolf_extinct_tick = t + 1;
+        out->sum_rabbits += s.rabbits;
+        out->sum_wolves += s.wolves;
+        out->sum_grass += s.grass;
+        out->stat_ticks++;
+    }
+    out->last = s;
+}
+
+// 文本格式：版本行、繁殖参数行，之后每个季节一行样本数与决定系数，再接三行系数，便于查看和手工调整
+int surrogate_save(const char* path, const SurrogateModel* model) {
+    FILE* f = fopen(path, "w");
+    if (!f) return 0;
+    fprintf(f, "ECOSURR %d\n", SURROGATE_VERSION);
+    fprintf(f, "params %.17g %d %.17g %d\n", model->rabbit_breed_prob, model->rabbit_breed_energy,
+        model->wolf_breed_prob, model->wolf_breed_energy);
+    fprintf(f, "# 每季节: season 编号 samples 样本数 r2 三个方程的决定系数；其后 grass/rabbit/wolf 各一行 1 g r w gr rw gw 的系数\n");
+    for (int s = 0; s < 4; s++) {
+        fprintf(f, "season %d samples %lld r2 %.6f %.6f %.6f\n",
+            s, model->samples[s], model->r2[s][0], model->r2[s][1], model->r2[s][2]);
+        for (int eq = 0; eq < 3; eq++) {
+            const double* c = model_row((SurrogateModel*)model, eq, s);
+            fprintf(f, "%s", equation_names[eq]);
+            for (int k = 0; k < SURROGATE_TERMS; k++) fprintf(f, " %.17g", c[k]);
+            fprintf(f, "\n");
+        }
+    }
+    return fclose(f) == 0;
+}
+
+int surrogate_load(const char* path, SurrogateModel* model) {
+    FILE* f = fopen(path, "r");
+    if (!f) return 0;
+    memset(model, 0, sizeof(*model));
+    char line[512];
+    int version = 0, ok = fgets(line, sizeof(line), f) && sscanf(line, "ECOSURR %d", &version) == 1
+        && version == SURROGATE_VERSION
+        && fgets(line, sizeof(line), f) && sscanf(line, "params %lf %d %lf %d", &model->rabbit_breed_prob,
+            &model->rabbit_breed_energy, &model->wolf_breed_prob, &model->wolf_breed_energy) == 4;
+    int rows = 0;
+    while (ok && fgets(line, sizeof(line), f)) {
+        if (line[0] == '#' || line[0] == '\n' || line[0] == '\r') continue;
+        int s = rows / 4, eq = rows % 4 - 1;
+        if (s >= 4) ok = 0;
+        else if (eq < 0) {
+            int idx;
+            ok = sscanf(line, "season %d samples %lld r2 %lf %lf %lf", &idx, &model->samples[s],
+                &model->r2[s][0], &model->r2[s][1], &model->r2[s][2]) == 5 && idx == s;
+        }
+        else {
+            char name[16];
+            int pos = 0;
+            double* c = model_row(model, eq, s);
+            ok = sscanf(line, "%15s%n", name, &pos) == 1 && strcmp(name, equation_names[eq]) == 0;
+            for (int k = 0; ok && k < SURROGATE_TERMS; k++) {
+                int used = 0;
+                ok = sscanf(line + pos, "%lf%n", &c[k], &used) == 1;
+                pos += used;
+            }
+        }
+        rows++;
+    }
+    fclose(f);
+    return ok && rows == 16;
+}
@@ -0,0 +1,56 @@
+﻿// 平均场替代模型：按季节的 Lotka–Volterra 式差分方程，只跟踪青草/兔子/狼的占格比例，
+// 每回合几次乘加，代替逐格的智能体模拟做快速的趋势预测。系数由智能体模拟的轨迹用最小二乘拟合
+#pragma once
+
+#include "ecosystem.h"
+
+#define SURROGATE_TERMS 7 // 每个方程的项：1, g, r, w, gr, rw, gw（g/r/w 为青草/兔子/狼占格子数的比例）
+#define SURROGATE_VERSION 1
+
+// 每个季节一组系数，x = (1, g, r, w, gr, rw, gw)：
+//   Δg = grass·x          青草在空地上生长 (1-g-r-w)、被兔子吃掉 (gr)
+//   Δr = r · rabbit·x     兔子的人均增长率随青草增加、随狼减少
+//   Δw = w · wolf·x       狼的人均增长率随兔子增加
+// 只有一次项时单步拟合得不错，但长时间推进会发散到兔子占满地图；加上两两乘积的相互作用项后
+// 能稳定地重现季节性的周期
+typedef struct {
+    double grass[4][SURROGATE_TERMS];
+    double rabbit[4][SURROGATE_TERMS];
+    double wolf[4][SURROGATE_TERMS];
+    double r2[4][3];       // 拟合时各季节三个方程的决定系数，仅供参考
+    long long samples[4];  // 拟合时各季节的样本（回合）数
+    // 拟合时的繁殖参数：系数只对这组参数有效
+    double rabbit_breed_prob, wolf_breed_prob;
+    int rabbit_breed_energy, wolf_breed_energy;
+} SurrogateModel;
+
+// 数量以格子数计，与智能体模拟的统计一致
+typedef struct {
+    double grass, rabbits, wolves;
+} SurrogateState;
+
+// 与批处理统计口径相同的结果：峰值、谷值（不计 0）、灭绝回合与平均数量
+typedef struct {
+    SurrogateState last;
+    double max_rabbits, max_wolves, min_rabbits, min_wolves;
+    int rabbit_extinct_tick, wolf_extinct_tick;
+    double sum_rabbits, sum_wolves, sum_grass;
+    int stat_ticks;
+} SurrogateResult;
+
+// 拟合用的正规方程累加器：[方程][季节]
+typedef struct {
+    double xtx[3][4][SURROGATE_TERMS][SURROGATE_TERMS];
+    double xty[3][4][SURROGATE_TERMS];
+    double yty[3][4];
+    double ysum[3][4];
+    long long samples[4];
+} SurrogateFit;
+
+void surrogate_fit_add(SurrogateFit* fit, int season, double cells, const SurrogateState* before, const SurrogateState* after);
+int surrogate_fit_solve(const SurrogateFit* fit, SurrogateModel* model);
+void surrogate_step(const SurrogateModel* model, int season, double cells, SurrogateState* s);
+void surrogate_run(const SurrogateModel* model, double cells, int first_tick, int last_tick,
+    const SurrogateState* start, SurrogateResult* out);
+int surrogate_save(const char* path, const SurrogateModel* model);
+int surrogate_load(const char* path, SurrogateModel* model);
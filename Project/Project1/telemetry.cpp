@@ -0,0 +1,311 @@
+﻿#define _CRT_SECURE_NO_WARNINGS
+#include "telemetry.h"
+#include "species.h"
+#include "domain.h"
+#include "profile.h"
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0 // macOS 没有这个标志，改用 SO_NOSIGPIPE
+#endif
+
+#define TELEMETRY_FRESH 4 // 三重缓冲的中间格有未取走的新数据
+
+// 模拟线程发布的一份快照；服务线程只读这里，不碰模拟的全局变量
+typedef struct {
+    int valid;       // 0 表示还没有发布过
+    int finished;    // 批处理已走完全部回合
+    double time;     // 发布时刻 (now_seconds)
+    int tick, season;
+    unsigned int seed;
+    int width, height;
+    int grass, counts[ANIMAL_SPECIES];
+    int births[ANIMAL_SPECIES], deaths[ANIMAL_SPECIES], predations[ANIMAL_SPECIES];
+    int max_counts[ANIMAL_SPECIES], min_counts[ANIMAL_SPECIES];
+    int extinct_ticks[ANIMAL_SPECIES];
+    double ticks_per_sec, mean_ticks_per_sec;
+    double phase_last[TELE_PHASES], phase_mean[TELE_PHASES]; // 秒
+} TelemetrySnapshot;
+
+static const char* phase_keys[] = { "update_grass", "update_entities", "domain_exchange", "record_stats" };
+static_assert(sizeof(phase_keys) / sizeof(phase_keys[0]) == TELE_PHASES, "每个阶段都要有名字");
+
+// 三重缓冲：写方独占 back，读方独占 front，middle 在两者之间原子交换
+static TelemetrySnapshot snapshots[3];
+static std::atomic<int> middle(1);
+static int back = 0;  // 仅模拟线程使用
+static int front = 2; // 仅服务线程使用
+
+static int active = 0;
+static std::atomic<int> serve_quit(0);
+static std::thread serve_thread;
+static int listen_fd = -1;
+static char socket_path[108] = ""; // Unix 套接字的路径，退出时删除
+static double start_time = 0;
+
+// 写方的统计：最近一个窗口的起点和自开始以来的累计用时
+static int window_tick = 0, first_tick = 0, last_tick = -1;
+static double window_time = 0, first_time = 0, window_rate = 0;
+static double phase_prev[TELE_PHASES], phase_sum[TELE_PHASES];
+static long long phase_ticks = 0;
+
+// 每回合结束后由模拟线程调用（多进程时只有主进程），phase_seconds 为本回合各阶段的用时；
+// 为 NULL 时沿用上一回合的用时（如批处理结束时标记 finished）。未开启监控时直接返回
+void telemetry_publish(const double* phase_seconds, int finished) {
+    if (!active) return;
+    double now = now_seconds();
+    if (last_tick < 0 || tick < last_tick) { // 第一次发布或交互模式下重置了世界
+        window_tick = first_tick = tick;
+        window_time = first_time = now;
+        window_rate = 0;
+        memset(phase_prev, 0, sizeof(phase_prev));
+        memset(phase_sum, 0, sizeof(phase_sum));
+        phase_ticks = 0;
+    }
+    last_tick = tick;
+    if (now - window_time >= TELEMETRY_RATE_WINDOW) {
+        window_rate = (tick - window_tick) / (now - window_time);
+        window_tick = tick;
+        window_time = now;
+    }
+
+    TelemetrySnapshot* s = &snapshots[back];
+    s->valid = 1;
+    s->finished = finished;
+    s->time = now;
+    s->tick = tick;
+    s->season = season;
+    s->seed = rand_seed;
+    s->width = grid_w;
+    s->height = grid_h;
+    s->grass = grass_count;
+    for (int k = 0; k < ANIMAL_SPECIES; k++) {
+        s->counts[k] = species_count[k];
+        s->births[k] = species_births[k];
+        s->deaths[k] = species_deaths[k];
+        s->predations[k] = species_predations[k];
+        s->max_counts[k] = species_max[k];
+        s->min_counts[k] = species_min[k] == INT_MAX ? 0 : species_min[k];
+        s->extinct_ticks[k] = species_extinct_tick[k];
+    }
+    double mean = now > first_time ? (tick - first_tick) / (now - first_time) : 0.0;
+    s->mean_ticks_per_sec = mean;
+    s->ticks_per_sec = window_rate > 0 ? window_rate : mean; // 第一个窗口走完之前用平均值
+    if (phase_seconds) {
+        phase_ticks++;
+        for (int p = 0; p < TELE_PHASES; p++) {
+            phase_prev[p] = phase_seconds[p];
+            phase_sum[p] += phase_seconds[p];
+        }
+    }
+    for (int p = 0; p < TELE_PHASES; p++) {
+        s->phase_last[p] = phase_prev[p];
+        s->phase_mean[p] = phase_ticks ? phase_sum[p] / phase_ticks : 0.0;
+    }
+    back = middle.exchange(back | TELEMETRY_FRESH, std::memory_order_acq_rel) & 3;
+}
+
+#ifndef _WIN32
+// 往 buf 末尾追加格式化文本，超出时截断；返回新的长度
+static int append(char* buf, int len, int size, const char* fmt, ...) {
+    if (len >= size) return len;
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(buf + len, size - len, fmt, ap);
+    va_end(ap);
+    return n < 0 ? len : (len + n < size ? len + n : size - 1);
+}
+
+// 取最新的快照写成 JSON
+static int telemetry_json(char* buf, int size) {
+    if (middle.load(std::memory_order_acquire) & TELEMETRY_FRESH)
+        front = middle.exchange(front, std::memory_order_acq_rel) & 3;
+    const TelemetrySnapshot* s = &snapshots[front];
+    double now = now_seconds();
+    if (!s->valid) return append(buf, 0, size, "{\"state\":\"starting\",\"uptime_s\":%.3f}\n", now - start_time);
+
+    int n = append(buf, 0, size, "{\"state\":\"%s\",\"uptime_s\":%.3f,\"age_s\":%.3f,\"processes\":%d,"
+        "\"tick\":%d,\"season\":%d,\"season_name\":\"%s\",\"seed\":%u,\"width\":%d,\"height\":%d,\"grass\":%d",
+        s->finished ? "finished" : "running", now - start_time, now - s->time, process_count,
+        s->tick, s->season, season_names[s->season], s->seed, s->width, s->height, s->grass);
+    // 各物种的键取自特性表：数量为 <key>，事件为 <prefix>_births 等，捕食次数只对捕食者输出
+    for (int k = 0; k < ANIMAL_SPECIES; k++) n = append(buf, n, size, ",\"%s\":%d", SPECIES[k].key, s->counts[k]);
+    n = append(buf, n, size, ",\"events\":{");
+    for (int k = 0; k < ANIMAL_SPECIES; k++)
+        n = append(buf, n, size, "%s\"%s_births\":%d", k ? "," : "", SPECIES[k].prefix, s->births[k]);
+    for (int k = 0; k < ANIMAL_SPECIES; k++) n = append(buf, n, size, ",\"%s_deaths\":%d", SPECIES[k].prefix, s->deaths[k]);
+    for (int k = 0; k < ANIMAL_SPECIES; k++) {
+        if (SPECIES[k].food != GRASS) n = append(buf, n, size, ",\"%s_predations\":%d", SPECIES[k].prefix, s->predations[k]);
+    }
+    n = append(buf, n, size, "},\"extrema\":{");
+    for (int k = 0; k < ANIMAL_SPECIES; k++)
+        n = append(buf, n, size, "%s\"max_%s\":%d", k ? "," : "", SPECIES[k].key, s->max_counts[k]);
+    for (int k = 0; k < ANIMAL_SPECIES; k++) n = append(buf, n, size, ",\"min_%s\":%d", SPECIES[k].key, s->min_counts[k]);
+    for (int k = 0; k < ANIMAL_SPECIES; k++)
+        n = append(buf, n, size, ",\"%s_extinct_tick\":%d", SPECIES[k].prefix, s->extinct_ticks[k]);
+    n = append(buf, n, size, "}");
+    n = append(buf, n, size, ",\"ticks_per_sec\":%.2f,\"mean_ticks_per_sec\":%.2f,\"phases\":[",
+        s->ticks_per_sec, s->mean_ticks_per_sec);
+    for (int p = 0; p < TELE_PHASES; p++) {
+        n = append(buf, n, size, "%s{\"name\":\"%s\",\"last_ms\":%.4f,\"mean_ms\":%.4f}", p ? "," : "",
+            phase_keys[p], s->phase_last[p] * 1e3, s->phase_mean[p] * 1e3);
+    }
+    n = append(buf, n, size, "]");
+#ifdef ECO_PROFILE
+    // 细分阶段的计数器本身是原子量，服务线程直接读取
+    n = append(buf, n, size, ",\"profile\":[");
+    for (int p = 0; p < PROF_PHASES; p++) {
+        long long calls = prof_phase_calls(p);
+        n = append(buf, n, size, "%s{\"name\":\"%s\",\"calls\":%lld,\"mean_us\":%.3f}", p ? "," : "",
+            prof_phase_names[p], calls, calls ? prof_phase_seconds(p) * 1e6 / calls : 0.0);
+    }
+    n = append(buf, n, size, "]");
+#endif
+    return append(buf, n, size, "}\n");
+}
+
+// 处理一个连接：读请求行，GET / 或 /telemetry 返回 JSON，其余返回 404/405。读写都有超时，
+// 慢的客户端最多占用服务线程一秒
+static void telemetry_answer(int fd) {
+    struct timeval timeout = { 1, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+#ifdef SO_NOSIGPIPE
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+    char req[2048];
+    int len = 0;
+    while (len < (int)sizeof(req) - 1) {
+        ssize_t got = recv(fd, req + len, sizeof(req) - 1 - len, 0);
+        if (got <= 0) break;
+        len += (int)got;
+        req[len] = '\0';
+        if (strstr(req, "\r\n\r\n") || strstr(req, "\n\n")) break;
+    }
+    req[len] = '\0';
+
+    static char body[8192];
+    const char* status = "200 OK";
+    int body_len;
+    if (strncmp(req, "GET ", 4) != 0) {
+        status = "405 Method Not Allowed";
+        body_len = append(body, 0, sizeof(body), "{\"error\":\"only GET is supported\"}\n");
+    }
+    else {
+        const char* path = req + 4;
+        size_t path_len = strcspn(path, " ?\r\n");
+        if ((path_len == 1 && path[0] == '/') || (path_len == 10 && strncmp(path, "/telemetry", 10) == 0)) {
+            body_len = telemetry_json(body, sizeof(body));
+        }
+        else {
+            status = "404 Not Found";
+            body_len = append(body, 0, sizeof(body), "{\"error\":\"not found\"}\n");
+        }
+    }
+    char head[256];
+    int head_len = snprintf(head, sizeof(head), "HTTP/1.0 %s\r\nContent-Type: application/json\r\n"
+        "Content-Length: %d\r\nCache-Control: no-store\r\nConnection: close\r\n\r\n", status, body_len);
+    if (send(fd, head, head_len, MSG_NOSIGNAL) == head_len) send(fd, body, body_len, MSG_NOSIGNAL);
+}
+
+// 服务线程：一次处理一个连接，每 0.1 秒检查一次是否该退出
+static void telemetry_serve() {
+    while (!serve_quit.load()) {
+        struct pollfd pfd = { listen_fd, POLLIN, 0 };
+        if (poll(&pfd, 1, 100) <= 0) continue;
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) continue;
+        telemetry_answer(fd);
+        close(fd);
+    }
+}
+#endif
+
+// 打开监控端点并启动服务线程。spec 为端口号时监听 127.0.0.1 的该端口（0 为任选一个空闲端口），
+// 否则视为 Unix 套接字的路径（可加 unix: 前缀）。多进程时只在主进程、分出子进程之后调用
+int telemetry_start(const char* spec) {
+#ifdef _WIN32
+    (void)spec;
+    fprintf(stderr, "监控端点 (--telemetry) 目前只支持 Linux/macOS\n");
+    return 0;
+#else
+    char* end;
+    long port = strtol(spec, &end, 10);
+    int is_port = end != spec && *end == '\0';
+    if (is_port) {
+        if (port < 0 || port > 65535) {
+            fprintf(stderr, "监控端口无效: %s\n", spec);
+            return 0;
+        }
+        listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+        int one = 1;
+        if (listen_fd >= 0) setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons((unsigned short)port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK); // 只接受本机连接
+        socklen_t addr_len = sizeof(addr);
+        if (listen_fd < 0 || bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0
+            || listen(listen_fd, 8) != 0 || getsockname(listen_fd, (struct sockaddr*)&addr, &addr_len) != 0) {
+            fprintf(stderr, "无法监听 127.0.0.1:%ld\n", port);
+            if (listen_fd >= 0) close(listen_fd);
+            listen_fd = -1;
+            return 0;
+        }
+        fprintf(stderr, "监控端点: http://127.0.0.1:%d/telemetry\n", ntohs(addr.sin_port));
+    }
+    else {
+        const char* path = strncmp(spec, "unix:", 5) == 0 ? spec + 5 : spec;
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (!*path || strlen(path) >= sizeof(addr.sun_path) || strlen(path) >= sizeof(socket_path)) {
+            fprintf(stderr, "Unix 套接字路径为空或过长: %s\n", path);
+            return 0;
+        }
+        strcpy(addr.sun_path, path);
+        // 上次异常退出时留下的套接字文件会让 bind 失败；只删除套接字，不动同名的普通文件
+        struct stat st;
+        if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode)) unlink(path);
+        listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listen_fd < 0 || bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(listen_fd, 8) != 0) {
+            fprintf(stderr, "无法监听 Unix 套接字: %s\n", path);
+            if (listen_fd >= 0) close(listen_fd);
+            listen_fd = -1;
+            return 0;
+        }
+        strcpy(socket_path, path);
+        fprintf(stderr, "监控端点: Unix 套接字 %s（如 curl --unix-socket %s http://localhost/telemetry）\n", path, path);
+    }
+    start_time = now_seconds();
+    last_tick = -1;
+    serve_quit.store(0);
+    serve_thread = std::thread(telemetry_serve);
+    active = 1;
+    return 1;
+#endif
+}
+
+void telemetry_stop() {
+    if (!active) return;
+    active = 0;
+#ifndef _WIN32
+    serve_quit.store(1);
+    serve_thread.join();
+    close(listen_fd);
+    listen_fd = -1;
+    if (socket_path[0]) unlink(socket_path);
+    socket_path[0] = '\0';
+#endif
+}
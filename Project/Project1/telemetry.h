@@ -0,0 +1,22 @@
+﻿// 运行监控：--telemetry 在本机开一个只读的 HTTP 端点（回环地址的端口，或 Unix 套接字），
+// 以 JSON 返回当前回合、季节、各物种数量、峰谷值、回合速度和各阶段用时，供无界面的批处理在服务器上查看。
+// 模拟线程每回合把这些值写进三重缓冲的一格，再用一次原子交换发布；服务线程同样用原子交换取走最新的一格。
+// 两边都不等待对方，监控不会拖慢回合
+#pragma once
+
+#include "ecosystem.h"
+
+#define TELEMETRY_RATE_WINDOW 1.0 // 回合速度按最近这么多秒计算
+
+// 每回合计时的阶段；多进程时“交换”为 domain_exchange，其余模式为 0
+enum {
+    TELE_GRASS = 0, // update_grass
+    TELE_ENTITIES,  // update_entities
+    TELE_EXCHANGE,  // domain_exchange
+    TELE_STATS,     // record_tick_stats 与录制
+    TELE_PHASES
+};
+
+int telemetry_start(const char* spec);
+void telemetry_publish(const double* phase_seconds, int finished);
+void telemetry_stop();
@@ -0,0 +1,32 @@
+# 捕食者不应多过猎物：兔子、狼和狐狸同场运行，捕食者的峰值与平均数量之和都不超过兔子。
+# 猎物被吃掉后从地图上移除，捕食者只能靠吃到的兔子维持，数量随兔子涨落。
+# 用法：cmake -DECOSYSTEM=<ecosystem 可执行文件> -P predation_bounded.cmake
+execute_process(
+    COMMAND ${ECOSYSTEM} --batch --csv --seed 1 --width 150 --height 150
+            --rabbits 4000 --wolves 200 --foxes 200 --ticks 1000
+    OUTPUT_VARIABLE out
+    RESULT_VARIABLE rc)
+if(NOT rc EQUAL 0)
+    message(FATAL_ERROR "ecosystem 退出码 ${rc}")
+endif()
+
+string(REPLACE "\n" ";" lines "${out}")
+list(GET lines 0 header)
+list(GET lines 1 row)
+string(REPLACE "," ";" header "${header}")
+string(REPLACE "," ";" row "${row}")
+foreach(key max_rabbits max_wolves max_foxes mean_rabbits mean_wolves mean_foxes)
+    list(FIND header ${key} i)
+    if(i LESS 0)
+        message(FATAL_ERROR "输出中没有 ${key} 列")
+    endif()
+    list(GET row ${i} value)
+    string(REGEX REPLACE "\\..*" "" ${key} "${value}") # 平均数量只比较整数部分
+endforeach()
+
+math(EXPR max_predators "${max_wolves} + ${max_foxes}")
+math(EXPR mean_predators "${mean_wolves} + ${mean_foxes}")
+message(STATUS "峰值 兔子 ${max_rabbits} / 捕食者 ${max_predators}，平均 兔子 ${mean_rabbits} / 捕食者 ${mean_predators}")
+if(max_predators GREATER max_rabbits OR mean_predators GREATER mean_rabbits)
+    message(FATAL_ERROR "捕食者数量超过了兔子")
+endif()